@@ -0,0 +1,73 @@
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+
+#include "Object.h"
+
+
+#ifndef ROBOTNAVIGATION_JOURNAL_H
+#define ROBOTNAVIGATION_JOURNAL_H
+
+
+// A Journal is an append-only binary log of the objects added to, removed from and moved on a Map. The Map logs each
+// change while its obstacles are still locked, so the records are in the order the changes were made.
+// A checkpoint of the whole obstacle set is kept next to it in <filename>.ckpt, together with the journal offset it
+// covers, so recovering only needs to read the checkpoint and replay the records written after it.
+class Journal {
+public:
+    using Ptr = std::shared_ptr<Journal>;    // shared pointer to Journal
+
+
+private:
+    std::string filename_;                                   // path of the journal file
+    std::ofstream out_;                                      // journal file, opened for appending
+    uint64_t offset_;                                        // size of the journal file once out_ is flushed
+    std::unordered_map<const Object *, uint64_t> ids_;      // id of each logged object
+    uint64_t next_id_;                                       // id given to the next new object
+    int checkpoint_interval_;                                // records between automatic checkpoints, 0 for never
+    int since_checkpoint_;                                   // records written since the last checkpoint
+    std::mutex lock_;                                        // serializes writes
+
+
+    // Get the id of an object, assigning a new one if it has none
+    uint64_t idOf(const Object *object);
+
+
+    // Flush the last record and check whether an automatic checkpoint is due
+    bool recorded();
+
+
+public:
+    Journal(std::string filename, int checkpoint_interval);
+
+
+    // Create a new, empty journal for a Map with the specified number of rows and columns, overwriting any old one
+    static Journal::Ptr create(const std::string &filename, int rows, int cols, int checkpoint_interval = 0);
+
+
+    // Restore the obstacles from the latest checkpoint and the records after it, and reopen the journal for appending.
+    // A record cut short by a crash is dropped. Returns nullptr if the journal can't be read.
+    static Journal::Ptr recover(const std::string &filename, int checkpoint_interval,
+                                int &rows, int &cols, std::vector<Object::Ptr> &objects);
+
+
+    // Log that an object was added, returns true if a checkpoint is due
+    bool logAdd(const Object::Ptr &object);
+
+
+    // Log that an object was removed, returns true if a checkpoint is due
+    bool logRemove(const Object::Ptr &object);
+
+
+    // Log that an object was moved, returns true if a checkpoint is due
+    bool logMove(const Object::Ptr &object);
+
+
+    // Write a checkpoint of the objects returned by snapshot, which is called while no record can be written
+    bool checkpoint(const std::function<std::vector<Object::Ptr>()> &snapshot);
+};
+
+
+#endif //ROBOTNAVIGATION_JOURNAL_H
@@ -0,0 +1,95 @@
+#include <vector>
+
+
+#include "Map.h"
+
+
+#ifndef ROBOTNAVIGATION_LOCALMAP_H
+#define ROBOTNAVIGATION_LOCALMAP_H
+
+
+// A LocalMap holds the clearance of a fixed size window of a much larger site, centered on a robot.
+// The window is a ring buffer: when it moves, the rows and columns that fall off one edge are reused for the strip
+// exposed on the other edge, and only that strip is computed, from the obstacle index of the site Map.
+// Clearance is capped at half the window size, so obstacles farther than that never need to be looked at.
+// The window only holds its clearance values, and catches up on changes made to the site when it is recentered.
+class LocalMap {
+public:
+    const int rows;          // number of rows in the window
+    const int cols;          // number of columns in the window
+    const int site_rows;     // number of rows in the site
+    const int site_cols;     // number of columns in the site
+    using Ptr = std::shared_ptr<LocalMap>;    // shared pointer to LocalMap
+
+
+private:
+    Map::Ptr site_;                    // the site, holding the obstacles and their index
+    double range_;                     // largest clearance value held by the window
+    int origin_x_;                     // site x coordinate of the window's first row
+    int origin_y_;                     // site y coordinate of the window's first column
+    bool placed_;                      // whether the window has been centered yet
+    uint64_t revision_;                // revision of the site the window reflects
+    std::vector<double> clearance_;    // ring buffer of clearance values
+
+
+    // Calculate the position in the ring buffer of a site coordinate
+    [[nodiscard]] int slot(int x, int y) const;
+
+
+    // Compute the clearance of the site cells in [x0, x1) x [y0, y1), which must lie in the window
+    void fill(int x0, int x1, int y0, int y1);
+
+
+public:
+    // Constructor to create a window of the specified size over a site
+    LocalMap(Map::Ptr site, int r, int c);
+
+
+    // Static method to create a window of the specified size over a site.
+    // The site Map can be deferred and never built, so it only holds the obstacles and their index.
+    static LocalMap::Ptr create(const Map::Ptr &site, int r, int c);
+
+
+    // Method to add an object to the site, updating the window if the object is near it
+    bool addObject(const Object::Ptr &object);
+
+
+    // Method to remove an object from the site, updating the window if the object was near it
+    bool removeObject(const Object::Ptr &object);
+
+
+    // Method to move an object of the site so its coordinate is at the specified x and y coordinates, updating the
+    // window if the object is near it. The object must not be held by any Map other than the site.
+    bool moveObject(const Object::Ptr &object, int x, int y);
+
+
+    // Method to recompute the cells of the window near the obstacles changed on the site since it was last updated
+    void sync();
+
+
+    // Method to center the window on a site coordinate, computing only the newly exposed cells
+    void recenter(int x, int y);
+
+
+    // Method to get the site x coordinate of the window's first row
+    [[nodiscard]] int originX() const;
+
+
+    // Method to get the site y coordinate of the window's first column
+    [[nodiscard]] int originY() const;
+
+
+    // Method to check whether a site coordinate is inside both the window and the site
+    [[nodiscard]] bool contains(int x, int y) const;
+
+
+    // Method to get the clearance at a site coordinate, or -1 outside the window or the site
+    [[nodiscard]] double valAt(int x, int y) const;
+
+
+    // Method to get the clearance at a site coordinate, or -1 outside the window or the site
+    [[nodiscard]] double valAt(const Coord &c) const;
+};
+
+
+#endif //ROBOTNAVIGATION_LOCALMAP_H
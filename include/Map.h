@@ -8,29 +8,51 @@
 #include <sstream>
 #include <opencv2/opencv.hpp>
 #include <unordered_map>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <deque>
 
 
 #include "Object.h"
+#include "Shapes.h"
+#include "Journal.h"
 
 
 #ifndef ROBOTNAVIGATION_MAP_H
 #define ROBOTNAVIGATION_MAP_H
 
 
+// The version of an object's current placement in a Map, shared by all of its MapItems, or 0 once it is removed
+using Placement = std::shared_ptr<std::atomic<uint64_t>>;
+
+
 // A MapItem is an item in the Map, consisting of a distance and an object
 struct MapItem {
 public:
     double dist;              // distance from the object
     Object::Ptr obj;          // object pointer
+    Placement placement;      // placement of the object in the Map
+    uint64_t version;         // version of the object's placement the distance was computed for
 
 
 public:
-    // Constructor to initialize MapItem with distance and object
-    explicit MapItem(double d, Object::Ptr o) : dist(d), obj(std::move(o)) {}
+    // Constructor to initialize MapItem with distance, object, placement and version
+    explicit MapItem(double d, Object::Ptr o, Placement p = nullptr, uint64_t v = 0)
+            : dist(d), obj(std::move(o)), placement(std::move(p)), version(v) {}
 };
 
 
-// A MapComp is a comparison object used by std::priority_queue to sort MapItems by distance
+// A Region is a rectangle of cells, rows x0 to x1 and columns y0 to y1, excluding x1 and y1
+struct Region {
+    int x0;
+    int x1;
+    int y0;
+    int y1;
+};
+
+
+// A MapComp is a comparison object used by the heap of each heat map cell to keep the nearest MapItem on top
 struct MapComp {
 public:
     // Operator to compare two MapItems by distance
@@ -41,34 +63,105 @@ public:
 
 
 // The Map class represents a map of objects with obstacles
+// Objects may be added, moved and removed concurrently from several threads; the heat map is split into tiles
+// that are locked independently, so updates in disjoint parts of the map do not wait on each other.
+// Queries (valAt, display, save) must not run while the Map is being modified.
 class Map {
 public:
     const int rows;     // number of rows in the map
     const int cols;     // number of columns in the map
     using Ptr = std::shared_ptr<Map>;    // shared pointer to Map
+    static constexpr int tile_size = 32;    // side length, in cells, of a heat map tile guarded by one lock
+    static constexpr int bucket_size = 32;    // side length, in cells, of an obstacle index bucket
+    static constexpr int change_log_size = 4096;    // number of recent changes kept for windows to catch up on
 
 
 private:
     std::vector<double> vert_dist_;    // vertical distances from edge
     std::vector<double> hor_dist_;     // horizontal distances edge
-    std::vector<std::priority_queue<MapItem, std::vector<MapItem>, MapComp>> heat_map_;    // heat map of MapItems sorted by distance
-    std::unordered_set<Object::Ptr> obstacles;    // set of obstacle object pointers
+    std::vector<std::vector<MapItem>> heat_map_;    // heat map of MapItems, each cell a heap ordered by MapComp
+    std::vector<double> clearance_;    // flat copy of the top of each heat map cell, or the edge distance if empty
+    std::vector<float> clearance_f_;   // single precision copy of clearance_, sampled by sampleClearance
+    std::unordered_map<Object::Ptr, Placement> obstacles;    // obstacle object pointers and their placement
+    std::unordered_map<uint64_t, std::vector<Object::Ptr>> index_;    // obstacles of every bucket their footprint overlaps
+    std::deque<Region> changes_;                  // footprints of the most recent changes to the obstacles, oldest last
+    uint64_t revision_;                           // number of changes made to the obstacles so far
+    uint64_t next_version_;                       // version given to the next placement of an object
+    int tile_cols_;                               // number of tile columns in the heat map
+    std::vector<std::mutex> tile_locks_;          // one lock per tile of the heat map, allocated when it is built
+    mutable std::shared_mutex obstacles_lock_;    // guards the obstacles, their index and the changes, but not the
+                                                  // versions of their placements
+    std::atomic<bool> built_;                     // whether heat_map_ and clearance_ reflect the obstacles
+    std::mutex build_lock_;                       // serializes the deferred build
+    Journal::Ptr journal_;                        // journal of mutations, or nullptr if not journaling
+
+
+private:
+    // Method to get the lock of the tile containing the specified x and y coordinate
+    std::mutex &tileLock(int x, int y);
+
+
+    // Method to set the clearance of a cell, in both precisions
+    void setClearance(int key, double value);
+
+
+    // Method to drop the entries on top of a heat map cell that are no longer live and update its clearance.
+    // The cell's tile must be locked.
+    void refresh(int key);
+
+
+    // Method to check whether a MapItem refers to an object still in the Map, at its current placement
+    bool isLive(const MapItem &item) const;
+
+
+    // Method to get the cells a BFS over an object's range of influence starts from, empty if the object is
+    // entirely off the Map
+    [[nodiscard]] std::vector<Coord> seedsOf(const Object::Ptr &object) const;
+
+
+    // Method to get the box of cells of the Map an object's footprint may overlap
+    [[nodiscard]] Region footprint(const Object::Ptr &object) const;
+
+
+    // Method to add an object to, or remove it from, the index buckets a footprint overlaps and record the change.
+    // The obstacles must be locked.
+    void reindex(const Object::Ptr &object, const Region &region, bool add);
+
+
+    // Method to get the box of cells an object can influence, wherever it is
+    [[nodiscard]] Region influenceBox(const Object::Ptr &object) const;
+
+
+    // Method to call fn(key, dist) for every cell of the box reachable from the seeds whose dist(cell) is within its
+    // edge distance
+    template<typename D, typename F>
+    void forEachWithin(const std::vector<Coord> &seeds, const Region &box, D dist, F fn);
+
+
+    // Method to call fn(key, dist) for every cell within the range of influence of an object
+    template<typename F>
+    void forEachInfluenced(const Object::Ptr &object, F fn);
 
 
 public:
-    // Constructor to create a Map with specified number of rows and columns
-    Map(int r, int c);
+    // Constructor to create a Map with specified number of rows and columns.
+    // If deferred, obstacles are only recorded until the heat map is first needed, then built in one pass.
+    Map(int r, int c, bool deferred = false);
 
 
     // Static method to create a Map shared pointer with specified number of rows and columns
-    static Map::Ptr createMap(int r, int c);
+    static Map::Ptr createMap(int r, int c, bool deferred = false);
+
+
+    // Method to build the heat map of a deferred Map now, does nothing if it is already built
+    void build();
 
 
     // Method to get the number of objects in the Map
     int numObjects();
 
 
-    // Method to add an object to the Map
+    // Method to add an object to the Map, part of it may lie off the Map
     bool addObject(const Object::Ptr &object);
 
 
@@ -84,6 +177,25 @@ public:
     Object::Ptr removeObject(int x, int y, double r);
 
 
+    // Method to move an object of the Map so its coordinate is at the specified x and y coordinates, part of it may
+    // then lie off the Map. The object itself is moved, so it must not be held by any other Map, whose heat map would
+    // still describe the old position.
+    bool moveObject(const Object::Ptr &object, int x, int y);
+
+
+    // Method to move several objects of the Map in parallel, returns the number of objects moved.
+    // Each object may appear only once, and like moveObject must not be held by any other Map.
+    int moveObjects(const std::vector<std::pair<Object::Ptr, Coord>> &moves, int num_threads = 0);
+
+
+    // Method to add several objects to the Map in parallel, returns the number of objects added
+    int addObjects(const std::vector<Object::Ptr> &objects, int num_threads = 0);
+
+
+    // Method to remove several objects from the Map in parallel, returns the number of objects removed
+    int removeObjects(const std::vector<Object::Ptr> &objects, int num_threads = 0);
+
+
     // Method to clear the Map of all objects and obstacles
     void clearMap();
 
@@ -92,6 +204,19 @@ public:
     [[nodiscard]] std::vector<Object::Ptr> getObstacles() const;
 
 
+    // Method to get the obstacles whose footprint may overlap a region of the Map, from the Map's obstacle index
+    [[nodiscard]] std::vector<Object::Ptr> obstaclesIn(const Region &region) const;
+
+
+    // Method to get the number of changes made to the obstacles so far
+    [[nodiscard]] uint64_t revision() const;
+
+
+    // Method to append the footprints changed after a revision to regions and advance the revision to the current one.
+    // Returns false if some of those changes are too old to be kept.
+    bool changesSince(uint64_t &revision, std::vector<Region> &regions) const;
+
+
     // Method to get the value at a specified coordinate in the Map
     double valAt(const Coord &c);
 
@@ -100,6 +225,12 @@ public:
     double valAt(int x, int y);
 
 
+    // Method to sample the bilinearly interpolated value at n continuous (x, y) positions, optionally with its gradient.
+    // Positions outside the Map are clamped to its border. grad_x and grad_y may be null.
+    void sampleClearance(const float *xs, const float *ys, std::size_t n, float *out,
+                         float *grad_x = nullptr, float *grad_y = nullptr);
+
+
     // Method to display the Map, optionally with a heat map
     cv::Mat display(bool show_heat_map);
 
@@ -110,6 +241,19 @@ public:
 
     // Static method to load a Map from a file and return a shared pointer to it
     static Map::Ptr load(const std::string &filename);
+
+
+    // Method to start journaling every mutation of the Map to a file, checkpointing the obstacles every
+    // checkpoint_interval mutations (0 for only on request)
+    bool openJournal(const std::string &filename, int checkpoint_interval = 0);
+
+
+    // Method to write a checkpoint of the obstacles, so recovery only replays the mutations after it
+    bool checkpoint();
+
+
+    // Static method to recover a Map from its journal and latest checkpoint, and keep journaling to it
+    static Map::Ptr recover(const std::string &filename, int checkpoint_interval = 0);
 };
 
 #endif //ROBOTNAVIGATION_MAP_H
\ No newline at end of file
@@ -4,6 +4,9 @@
 #include <vector>
 #include <iostream>
 #include <cmath>
+#include <memory>
+#include <string>
+#include <opencv2/core.hpp>
 
 
 #ifndef ROBOTNAVIGATION_OBJECT_H
@@ -27,11 +30,29 @@ struct Coord {
 };
 
 
+// The kinds of geometry an Object can have
+enum class Shape {
+    Disc,
+    Segment,
+    Box,
+    Polygon
+};
+
+
 class Object : public std::enable_shared_from_this<Object> {
+    friend class Map;        // moves the objects it holds
+    friend class Journal;    // replays moves
+
+
 protected:
     Coord coord;
 
 
+    // Move the whole Object by dx rows and dy columns. Maps share the Objects added to them, so a moved Object must
+    // belong to at most one Map.
+    virtual void translate(int dx, int dy);
+
+
 public:
     const double radius;
     using Ptr = std::shared_ptr<Object>;
@@ -40,10 +61,49 @@ public:
     Object(int i, int j, double r) : coord(Coord(i, j)), radius(r) {}
 
 
+    virtual ~Object() = default;
+
+
     // Create a shared pointer to an Object instance
     static Object::Ptr createObject(int x, int y, double radius);
 
 
+    // Create an Object of the given shape from the parameters returned by params(), or nullptr if they don't fit the shape
+    static Object::Ptr fromParams(Shape shape, const std::vector<double> &p);
+
+
+    // Return the name of a shape, as used in map files
+    static std::string shapeName(Shape shape);
+
+
+    // Parse the name of a shape, returns false if the name is unknown
+    static bool parseShape(const std::string &name, Shape &shape);
+
+
+    // Return the shape of the Object
+    [[nodiscard]] virtual Shape shape() const;
+
+
+    // Return the parameters describing the Object's geometry
+    [[nodiscard]] virtual std::vector<double> params() const;
+
+
+    // Check whether the Object's geometry is well formed
+    [[nodiscard]] virtual bool valid() const;
+
+
+    // Calculate the distance between the Object's boundary and a given coordinate (0 inside the Object)
+    [[nodiscard]] virtual double clearance(const Coord &c) const;
+
+
+    // Return the largest distance between the Object's coordinate and any point of the Object
+    [[nodiscard]] virtual double extent() const;
+
+
+    // Draw the Object onto an image
+    virtual void draw(cv::Mat &image, const cv::Vec3b &color) const;
+
+
     // Calculate the distance between an Object's coordinate and a given coordinate
     double dist(const Coord& c) const;
 
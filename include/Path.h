@@ -0,0 +1,109 @@
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+
+#include "Map.h"
+
+
+#ifndef ROBOTNAVIGATION_PATH_H
+#define ROBOTNAVIGATION_PATH_H
+
+
+// A CompactPath stores a path of adjacent cells as its first cell and a run-length encoding of the steps between
+// cells. Each run is one byte: the step's direction, one of 8, in the high 3 bits and the run length, 1 to 32, in the
+// low 5 bits. Straight stretches of a path cost one byte per 32 cells instead of 8 bytes per cell.
+class CompactPath {
+public:
+    // A forward iterator yielding the cells of a CompactPath one at a time, decoding as it goes
+    class iterator {
+    private:
+        const std::vector<uint8_t> *runs_;    // runs of the path being iterated
+        std::size_t run_;                     // index of the run holding the next step
+        int taken_;                           // number of steps already taken from that run
+        std::size_t index_;                   // index of the current cell in the path
+        Coord coord_;                         // current cell
+
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Coord;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Coord *;
+        using reference = const Coord &;
+
+
+        iterator(const std::vector<uint8_t> *runs, std::size_t index, Coord coord);
+
+
+        reference operator*() const { return coord_; }
+
+
+        pointer operator->() const { return &coord_; }
+
+
+        iterator &operator++();
+
+
+        iterator operator++(int);
+
+
+        bool operator==(const iterator &other) const { return index_ == other.index_; }
+
+
+        bool operator!=(const iterator &other) const { return index_ != other.index_; }
+    };
+
+
+private:
+    Coord origin_;                 // first cell of the path
+    std::size_t size_;             // number of cells in the path
+    std::vector<uint8_t> runs_;    // encoded steps
+
+
+public:
+    CompactPath();
+
+
+    // Encode a path, each cell must be one of the 8 neighbors of the one before it
+    explicit CompactPath(const std::vector<Coord> &path);
+
+
+    [[nodiscard]] iterator begin() const;
+
+
+    [[nodiscard]] iterator end() const;
+
+
+    // Return the number of cells in the path
+    [[nodiscard]] std::size_t size() const { return size_; }
+
+
+    // Check whether the path has no cells
+    [[nodiscard]] bool empty() const { return size_ == 0; }
+
+
+    // Return the number of bytes used to encode the path's steps
+    [[nodiscard]] std::size_t encodedSize() const { return runs_.size(); }
+
+
+    // Decode every cell of the path
+    [[nodiscard]] std::vector<Coord> coords() const;
+
+
+    // Reduce the path to the cells where it turns, skipping every cell a robot of the given radius can drive past in
+    // a straight line. A straight line is driveable when every cell it crosses has at least radius clearance on map.
+    [[nodiscard]] std::vector<Coord> waypoints(const Map::Ptr &map, double radius) const;
+
+
+    // Write the path to a stream, returns false if the stream fails
+    bool write(std::ostream &out) const;
+
+
+    // Read a path written by write, returns false and leaves the path empty if the stream ends first or is malformed
+    bool read(std::istream &in);
+};
+
+
+#endif //ROBOTNAVIGATION_PATH_H
@@ -0,0 +1,74 @@
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <vector>
+
+
+#include "Object.h"
+
+
+#ifndef ROBOTNAVIGATION_PATHQUERY_H
+#define ROBOTNAVIGATION_PATHQUERY_H
+
+
+// Progress of a path search, reported while it runs
+struct PathProgress {
+    long expanded;       // number of nodes expanded so far
+    double best_dist;    // distance to the target of the closest node expanded so far
+};
+
+
+// A callback receiving the progress of a path search. It is called on the thread running the search.
+using ProgressCallback = std::function<void(const PathProgress &)>;
+
+
+// A PathQuery is a handle to a path search running on another thread.
+// Copies of a PathQuery refer to the same search. Destroying the last one cancels the search without waiting for it.
+class PathQuery {
+private:
+    // Sets a cancel flag when destroyed, so the search stops once no PathQuery refers to it anymore
+    class Guard {
+    private:
+        std::shared_ptr<std::atomic<bool>> cancel_;
+
+
+    public:
+        explicit Guard(std::shared_ptr<std::atomic<bool>> cancel);
+
+
+        ~Guard();
+    };
+
+
+    std::shared_future<std::vector<Coord>> result_;    // the path found, empty if there is none or it was cancelled
+    std::shared_ptr<std::atomic<bool>> cancel_;        // set to ask the search to stop
+    std::shared_ptr<Guard> guard_;                     // shared by the copies of the PathQuery
+
+
+public:
+    PathQuery(std::shared_future<std::vector<Coord>> result, std::shared_ptr<std::atomic<bool>> cancel);
+
+
+    // Ask the search to stop as soon as possible, its path will be empty
+    void cancel();
+
+
+    // Check whether the search was asked to stop
+    [[nodiscard]] bool cancelled() const;
+
+
+    // Check whether the search has finished, without blocking
+    [[nodiscard]] bool ready() const;
+
+
+    // Block until the search has finished
+    void wait() const;
+
+
+    // Block until the search has finished and return its path
+    [[nodiscard]] const std::vector<Coord> &get() const;
+};
+
+
+#endif //ROBOTNAVIGATION_PATHQUERY_H
@@ -0,0 +1,73 @@
+#include <unordered_map>
+#include <vector>
+
+
+#include "Object.h"
+
+
+#ifndef ROBOTNAVIGATION_RESERVATIONTABLE_H
+#define ROBOTNAVIGATION_RESERVATIONTABLE_H
+
+
+// A ReservationTable records where already planned robots are at each time step, so robots planned later can avoid them.
+// Footprints are hashed by time step and by square bucket of the map, so a lookup only looks at nearby robots.
+class ReservationTable {
+private:
+    // A disc occupied by a robot
+    struct Footprint {
+        Coord c;          // center of the robot
+        double radius;    // radius of the robot
+        int from;         // first time step of a parked robot, unused for a moving one
+    };
+
+
+    int bucket_size_;                                                 // side length, in cells, of a bucket
+    double max_radius_;                                               // largest radius reserved so far
+    int last_step_;                                                   // last time step with a moving footprint
+    std::unordered_map<uint64_t, std::vector<Footprint>> moving_;     // footprints keyed by time step and bucket
+    std::unordered_map<uint64_t, std::vector<Footprint>> parked_;     // robots staying put forever, keyed by bucket
+    std::unordered_map<uint64_t, int> last_change_;                   // last time step a footprint enters each bucket
+
+
+    // Calculate the key of a bucket at a time step
+    [[nodiscard]] static uint64_t key(int t, int bx, int by);
+
+
+    // Check whether a disc overlaps any of the footprints in a list
+    [[nodiscard]] static bool overlaps(const std::vector<Footprint> &footprints, const Coord &c, double radius, int t);
+
+
+public:
+    using Ptr = std::shared_ptr<ReservationTable>;    // shared pointer to ReservationTable
+
+
+    explicit ReservationTable(int bucket_size = 8);
+
+
+    // Reserve a path, where path[t] is the robot's position at time step t. The robot stays at the end of the path.
+    void reserve(const std::vector<Coord> &path, double radius);
+
+
+    // Remove a robot parked at c from time step 0, as reserved by reserve({c}, radius)
+    void release(const Coord &c, double radius);
+
+
+    // Check whether a robot of the given radius can be at c at time step t
+    [[nodiscard]] bool isFree(const Coord &c, int t, double radius) const;
+
+
+    // Get the last time step at which a robot of the given radius at c could start or stop overlapping a reserved one,
+    // or -1 if none ever can. From the time step after it, c is either always free or never free.
+    [[nodiscard]] int lastChange(const Coord &c, double radius) const;
+
+
+    // Check whether a robot of the given radius can stay at c from time step t onward
+    [[nodiscard]] bool isFreeFrom(const Coord &c, int t, double radius) const;
+
+
+    // Remove all reservations
+    void clear();
+};
+
+
+#endif //ROBOTNAVIGATION_RESERVATIONTABLE_H
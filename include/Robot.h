@@ -5,6 +5,9 @@
 
 
 #include "Map.h"
+#include "ReservationTable.h"
+#include "PathQuery.h"
+#include "LocalMap.h"
 #include <utility>
 #include <memory>
 
@@ -17,6 +20,14 @@ private:
     Coord target_;   // The target location on the map for the robot
 
 
+    bool readyToPlan(double lambda);   // A method to check the robot has a map, start, target and lambda it can plan with
+
+
+    std::vector<Coord> search(double lambda, const LocalMap *window, bool save, const std::string &fn,
+                              const std::atomic<bool> *cancel, const ProgressCallback &progress,
+                              int progress_interval);   // The search behind pathFind, which can be cancelled and report progress
+
+
 public:
     using Ptr = std::shared_ptr<Robot>;   // A shared pointer to a robot object
 
@@ -44,6 +55,26 @@ public:
     std::vector<Coord> pathFind(double lambda, bool save, const std::string &fn = "output");   // A method to find a path for the robot on the map
 
 
+    std::vector<Coord> pathFindBidirectional(double lambda);   // A method to find a path by searching from both the start and the target
+
+
+    std::vector<std::vector<Coord>> pathFind(const std::vector<double> &lambdas);   // A method to find one path per lambda in a single pass
+
+
+    std::vector<Coord> pathFind(double lambda, LocalMap &window);   // A method to find a path within a local window of the site centered on the robot
+
+
+    PathQuery pathFindAsync(double lambda, const ProgressCallback &progress = nullptr,
+                            int progress_interval = 4096);   // A method to find a path on another thread, which can be cancelled
+
+
+    std::vector<Coord> pathFind(double lambda, const ReservationTable &reservations, int max_steps = 0);   // A method to find a path, one position per time step, avoiding reserved robots
+
+
+    static std::vector<std::vector<Coord>> pathFindAll(const std::vector<Robot::Ptr> &robots, double lambda,
+                                                       int max_steps = 0);   // A static method to plan robots in priority order without collisions
+
+
     void printParameters() const;   // A method to print the parameters of the robot object
 };
 
@@ -0,0 +1,131 @@
+#include "Object.h"
+
+
+#ifndef ROBOTNAVIGATION_SHAPES_H
+#define ROBOTNAVIGATION_SHAPES_H
+
+
+// A straight wall or conveyor line between two coordinates, inflated by its radius (half its width)
+class Segment : public Object {
+private:
+    Coord end_;    // the second endpoint, the first one is the Object's coordinate
+
+
+protected:
+    void translate(int dx, int dy) override;
+
+
+public:
+    using Ptr = std::shared_ptr<Segment>;
+
+
+    Segment(int x0, int y0, int x1, int y1, double r) : Object(x0, y0, r), end_(Coord(x1, y1)) {}
+
+
+    // Create a shared pointer to a Segment from (x0, y0) to (x1, y1) with the given half width
+    static Segment::Ptr create(int x0, int y0, int x1, int y1, double r = 0);
+
+
+    [[nodiscard]] Shape shape() const override;
+
+
+    [[nodiscard]] std::vector<double> params() const override;
+
+
+    // A Segment needs a non negative half width
+    [[nodiscard]] bool valid() const override;
+
+
+    [[nodiscard]] double clearance(const Coord &c) const override;
+
+
+    [[nodiscard]] double extent() const override;
+
+
+    void draw(cv::Mat &image, const cv::Vec3b &color) const override;
+};
+
+
+// An axis aligned box covering every cell between two corners, inclusive
+class Box : public Object {
+private:
+    Coord hi_;    // the corner with the largest coordinates, the other one is the Object's coordinate
+
+
+protected:
+    void translate(int dx, int dy) override;
+
+
+public:
+    using Ptr = std::shared_ptr<Box>;
+
+
+    Box(int x0, int y0, int x1, int y1) : Object(std::min(x0, x1), std::min(y0, y1), 0),
+                                          hi_(Coord(std::max(x0, x1), std::max(y0, y1))) {}
+
+
+    // Create a shared pointer to a Box with corners (x0, y0) and (x1, y1)
+    static Box::Ptr create(int x0, int y0, int x1, int y1);
+
+
+    [[nodiscard]] Shape shape() const override;
+
+
+    [[nodiscard]] std::vector<double> params() const override;
+
+
+    [[nodiscard]] bool valid() const override;
+
+
+    [[nodiscard]] double clearance(const Coord &c) const override;
+
+
+    [[nodiscard]] double extent() const override;
+
+
+    void draw(cv::Mat &image, const cv::Vec3b &color) const override;
+};
+
+
+// A simple closed polygon, such as the footprint of a shelving unit
+class Polygon : public Object {
+private:
+    std::vector<Coord> vertices_;    // vertices in order, the first one is the Object's coordinate
+
+
+protected:
+    void translate(int dx, int dy) override;
+
+
+public:
+    using Ptr = std::shared_ptr<Polygon>;
+
+
+    explicit Polygon(const std::vector<Coord> &vertices);
+
+
+    // Create a shared pointer to a Polygon with the given vertices
+    static Polygon::Ptr create(const std::vector<Coord> &vertices);
+
+
+    [[nodiscard]] Shape shape() const override;
+
+
+    [[nodiscard]] std::vector<double> params() const override;
+
+
+    // A Polygon needs at least three vertices
+    [[nodiscard]] bool valid() const override;
+
+
+    [[nodiscard]] double clearance(const Coord &c) const override;
+
+
+    [[nodiscard]] double extent() const override;
+
+
+    void draw(cv::Mat &image, const cv::Vec3b &color) const override;
+};
+
+
+#endif //ROBOTNAVIGATION_SHAPES_H
@@ -0,0 +1,276 @@
+#include <algorithm>
+#include <filesystem>
+
+
+#include "../include/Journal.h"
+
+
+// Record types and file signatures
+static const char ADD = 'A';
+static const char REMOVE = 'R';
+static const char MOVE = 'M';
+static const char JOURNAL_MAGIC[4] = {'R', 'N', 'J', '1'};
+static const char CHECKPOINT_MAGIC[4] = {'R', 'N', 'C', '1'};
+static const uint64_t HEADER_SIZE = sizeof(JOURNAL_MAGIC) + 2 * sizeof(int32_t);
+
+
+// Write a value as raw bytes, returns the number of bytes written
+template<typename T>
+static uint64_t put(std::ostream &out, const T &v) {
+    out.write(reinterpret_cast<const char *>(&v), sizeof(T));
+    return sizeof(T);
+}
+
+
+// Read a value written by put, returns false if the stream ends first
+template<typename T>
+static bool get(std::istream &in, T &v) {
+    return bool(in.read(reinterpret_cast<char *>(&v), sizeof(T)));
+}
+
+
+// Write the shape and parameters of an object
+static uint64_t putObject(std::ostream &out, const Object &object) {
+    const auto p = object.params();
+    uint64_t n = put(out, uint8_t(object.shape())) + put(out, uint32_t(p.size()));
+    out.write(reinterpret_cast<const char *>(p.data()), std::streamsize(p.size() * sizeof(double)));
+    return n + p.size() * sizeof(double);
+}
+
+
+// Read an object written by putObject, returns nullptr if the stream ends first or the object is malformed.
+// The parameter count comes from the file, so it must fit the shape, and a polygon's vertices are read in bounded
+// chunks so a corrupt count can't allocate more than the file actually holds.
+static Object::Ptr getObject(std::istream &in) {
+    static const uint32_t PARAMS[] = {3, 5, 4};    // parameters of a disc, segment and box
+    static const uint32_t CHUNK = 8192;
+    uint8_t shape;
+    uint32_t n;
+    if (!get(in, shape) || !get(in, n) || shape > uint8_t(Shape::Polygon)) {
+        return nullptr;
+    }
+    if (Shape(shape) == Shape::Polygon ? n < 6 || n % 2 != 0 : n != PARAMS[shape]) {
+        return nullptr;
+    }
+    std::vector<double> p;
+    for (uint32_t read = 0; read < n; read += std::min(CHUNK, n - read)) {
+        const uint32_t count = std::min(CHUNK, n - read);
+        p.resize(read + count);
+        if (!in.read(reinterpret_cast<char *>(p.data() + read), std::streamsize(count * sizeof(double)))) {
+            return nullptr;
+        }
+    }
+    return Object::fromParams(Shape(shape), p);
+}
+
+
+Journal::Journal(std::string filename, int checkpoint_interval)
+        : filename_(std::move(filename)), offset_(0), next_id_(0),
+          checkpoint_interval_(checkpoint_interval), since_checkpoint_(0) {}
+
+
+// Create a new journal, starting with a header holding the Map's dimensions
+Journal::Ptr Journal::create(const std::string &filename, int rows, int cols, int checkpoint_interval) {
+    auto journal = std::make_shared<Journal>(filename, checkpoint_interval);
+    journal->out_.open(filename, std::ios::binary | std::ios::trunc);
+    if (!journal->out_.is_open()) {
+        std::cerr << "Error: Could not open file " << filename << " for writing.\n";
+        return nullptr;
+    }
+    journal->out_.write(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    put(journal->out_, int32_t(rows));
+    put(journal->out_, int32_t(cols));
+    journal->out_.flush();
+    journal->offset_ = HEADER_SIZE;
+
+    // An old checkpoint would describe a different journal
+    std::error_code ec;
+    std::filesystem::remove(filename + ".ckpt", ec);
+    return journal;
+}
+
+
+// Recover the obstacles from the latest checkpoint and the tail of the journal
+Journal::Ptr Journal::recover(const std::string &filename, int checkpoint_interval,
+                              int &rows, int &cols, std::vector<Object::Ptr> &objects) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "Error: Could not open file " << filename << " for reading.\n";
+        return nullptr;
+    }
+    char magic[4];
+    int32_t r, c;
+    if (!in.read(magic, sizeof(magic)) || !std::equal(magic, magic + 4, JOURNAL_MAGIC) || !get(in, r) || !get(in, c)) {
+        std::cerr << "Error: " << filename << " is not a map journal.\n";
+        return nullptr;
+    }
+
+    auto journal = std::make_shared<Journal>(filename, checkpoint_interval);
+    std::unordered_map<uint64_t, Object::Ptr> live;
+    uint64_t offset = HEADER_SIZE;
+
+    // Start from the checkpoint, if there is a complete one
+    std::ifstream ckpt(filename + ".ckpt", std::ios::binary);
+    uint64_t ckpt_offset, next_id, count;
+    if (ckpt.read(magic, sizeof(magic)) && std::equal(magic, magic + 4, CHECKPOINT_MAGIC) &&
+        get(ckpt, ckpt_offset) && get(ckpt, next_id) && get(ckpt, count)) {
+        std::unordered_map<uint64_t, Object::Ptr> saved;
+        uint64_t id;
+        Object::Ptr object;
+        while (saved.size() < count && get(ckpt, id) && (object = getObject(ckpt)) != nullptr) {
+            saved[id] = object;
+        }
+        if (saved.size() == count) {
+            live = std::move(saved);
+            offset = ckpt_offset;
+            journal->next_id_ = next_id;
+        } else {
+            std::cerr << "Warning: Ignoring incomplete checkpoint " << filename << ".ckpt\n";
+        }
+    }
+
+    // Replay the records written after the checkpoint. The Map writes each record while its change is locked, so the
+    // records are in the order the Map changed. A record may already be reflected in the checkpoint, so replaying it
+    // again must do nothing: an add overwrites its id and a remove of a missing id is ignored. This only covers
+    // repeating records, not reordering them; a remove replayed before its add would bring the object back.
+    in.seekg(std::streamoff(offset));
+    char type;
+    uint64_t id;
+    while (in.get(type) && get(in, id)) {
+        if (type == ADD) {
+            auto object = getObject(in);
+            if (object == nullptr) {
+                break;
+            }
+            live[id] = object;
+        } else if (type == REMOVE) {
+            live.erase(id);
+        } else if (type == MOVE) {
+            int32_t x, y;
+            if (!get(in, x) || !get(in, y)) {
+                break;
+            }
+            // Moves hold the new coordinate, so replaying one that the checkpoint already reflects does nothing
+            auto iter = live.find(id);
+            if (iter != live.end()) {
+                iter->second->translate(x - iter->second->x(), y - iter->second->y());
+            }
+        } else {
+            break;
+        }
+        journal->next_id_ = std::max(journal->next_id_, id + 1);
+        offset = uint64_t(in.tellg());
+        journal->since_checkpoint_++;
+    }
+    in.close();
+
+    // Drop a record cut short by a crash, so new records are appended after the last complete one
+    std::error_code ec;
+    std::filesystem::resize_file(filename, offset, ec);
+    journal->out_.open(filename, std::ios::binary | std::ios::app);
+    if (ec || !journal->out_.is_open()) {
+        std::cerr << "Error: Could not open file " << filename << " for writing.\n";
+        return nullptr;
+    }
+    journal->offset_ = offset;
+
+    rows = r;
+    cols = c;
+    objects.clear();
+    objects.reserve(live.size());
+    for (const auto &entry: live) {
+        journal->ids_[entry.second.get()] = entry.first;
+        objects.push_back(entry.second);
+    }
+    return journal;
+}
+
+
+// Get the id of an object, assigning a new one if it has none
+uint64_t Journal::idOf(const Object *object) {
+    auto iter = ids_.find(object);
+    if (iter != ids_.end()) {
+        return iter->second;
+    }
+    ids_[object] = next_id_;
+    return next_id_++;
+}
+
+
+// Flush the last record and check whether an automatic checkpoint is due
+bool Journal::recorded() {
+    out_.flush();
+    since_checkpoint_++;
+    return checkpoint_interval_ > 0 && since_checkpoint_ >= checkpoint_interval_;
+}
+
+
+// Append an add record with the object's geometry
+bool Journal::logAdd(const Object::Ptr &object) {
+    std::lock_guard<std::mutex> lock(lock_);
+    out_.put(ADD);
+    offset_ += 1 + put(out_, idOf(object.get())) + putObject(out_, *object);
+    return recorded();
+}
+
+
+// Append a remove record. The record is written even for an object without an id yet, which replays as nothing.
+bool Journal::logRemove(const Object::Ptr &object) {
+    std::lock_guard<std::mutex> lock(lock_);
+    const uint64_t id = idOf(object.get());
+    out_.put(REMOVE);
+    offset_ += 1 + put(out_, id);
+    ids_.erase(object.get());
+    return recorded();
+}
+
+
+// Append a move record with the object's new coordinate
+bool Journal::logMove(const Object::Ptr &object) {
+    std::lock_guard<std::mutex> lock(lock_);
+    out_.put(MOVE);
+    offset_ += 1 + put(out_, idOf(object.get())) + put(out_, int32_t(object->x())) + put(out_, int32_t(object->y()));
+    return recorded();
+}
+
+
+// Write the checkpoint to a temporary file first and rename it over the old one, so a crash leaves either checkpoint whole
+bool Journal::checkpoint(const std::function<std::vector<Object::Ptr>()> &snapshot) {
+    std::lock_guard<std::mutex> lock(lock_);
+    const std::string tmp = filename_ + ".ckpt.tmp";
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Error: Could not open file " << tmp << " for writing.\n";
+        return false;
+    }
+
+    // Every record before offset_ is reflected in the snapshot, since objects are logged while they change the Map
+    const auto objects = snapshot();
+    std::vector<uint64_t> ids;
+    ids.reserve(objects.size());
+    for (const auto &object: objects) {
+        ids.push_back(idOf(object.get()));
+    }
+    out.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    put(out, offset_);
+    put(out, next_id_);
+    put(out, uint64_t(objects.size()));
+    for (size_t i = 0; i < objects.size(); i++) {
+        put(out, ids[i]);
+        putObject(out, *objects[i]);
+    }
+    out.close();
+    if (!out) {
+        std::cerr << "Error: Could not write checkpoint " << tmp << ".\n";
+        return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp, filename_ + ".ckpt", ec);
+    if (ec) {
+        std::cerr << "Error: Could not replace checkpoint " << filename_ << ".ckpt.\n";
+        return false;
+    }
+    since_checkpoint_ = 0;
+    return true;
+}
@@ -0,0 +1,179 @@
+#include "../include/LocalMap.h"
+
+
+// Create a window that isn't placed yet, it is computed the first time it is centered
+LocalMap::LocalMap(Map::Ptr site, int r, int c)
+        : rows(r), cols(c), site_rows(site->rows), site_cols(site->cols), site_(std::move(site)),
+          range_(std::max(r, c) / 2.), origin_x_(0), origin_y_(0), placed_(false), revision_(0) {
+    if (r < 1 || c < 1) {
+        throw std::invalid_argument("window rows and cols must be greater than or equal to 1");
+    }
+    clearance_.resize(rows * cols);
+}
+
+
+// Create a window over a site, it reads the site's obstacles from the site's own index
+LocalMap::Ptr LocalMap::create(const Map::Ptr &site, int r, int c) {
+    return std::make_shared<LocalMap>(site, r, c);
+}
+
+
+// Positive modulo, so the ring buffer wraps in both directions
+int LocalMap::slot(int x, int y) const {
+    return ((x % rows + rows) % rows) * cols + (y % cols + cols) % cols;
+}
+
+
+// Compute the clearance of a block of cells: the distance from the site's edge or the nearest obstacle, capped at range_
+void LocalMap::fill(int x0, int x1, int y0, int y1) {
+    x0 = std::max(x0, origin_x_);
+    x1 = std::min(x1, origin_x_ + rows);
+    y0 = std::max(y0, origin_y_);
+    y1 = std::min(y1, origin_y_ + cols);
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    // Gather the obstacles that may come within range of the block once, rather than for every cell
+    const int reach = int(std::ceil(range_));
+    const std::vector<Object::Ptr> nearby = site_->obstaclesIn({x0 - reach, x1 + reach, y0 - reach, y1 + reach});
+
+    for (int x = x0; x < x1; x++) {
+        for (int y = y0; y < y1; y++) {
+            if (x < 0 || x >= site_rows || y < 0 || y >= site_cols) {
+                clearance_[slot(x, y)] = -1;
+                continue;
+            }
+            // Same edge distance as Map
+            const double vert = x < site_rows / 2 ? x : site_rows - (x + 1);
+            const double hor = y < site_cols / 2 ? y : site_cols - (y + 1);
+            double best = std::min({vert, hor, range_});
+            const Coord c(x, y);
+            for (const auto &obj: nearby) {
+                // skip objects that can't be closer than the best so far
+                if (obj->dist(c) - obj->extent() < best) {
+                    best = std::min(best, obj->clearance(c));
+                }
+            }
+            clearance_[slot(x, y)] = best;
+        }
+    }
+}
+
+
+// Add the object to the site, and bring the window up to date with it
+bool LocalMap::addObject(const Object::Ptr &object) {
+    if (!site_->addObject(object)) {
+        return false;
+    }
+    sync();
+    return true;
+}
+
+
+// Remove the object from the site, and bring the window up to date without it
+bool LocalMap::removeObject(const Object::Ptr &object) {
+    if (!site_->removeObject(object)) {
+        return false;
+    }
+    sync();
+    return true;
+}
+
+
+// Move the object on the site, and bring the window up to date with both where it was and where it is
+bool LocalMap::moveObject(const Object::Ptr &object, int x, int y) {
+    if (!site_->moveObject(object, x, y)) {
+        return false;
+    }
+    sync();
+    return true;
+}
+
+
+// Recompute the cells of the window within range of the footprints changed on the site, or the whole window if the
+// site changed too much for its log to tell where
+void LocalMap::sync() {
+    std::vector<Region> changed;
+    const bool complete = site_->changesSince(revision_, changed);
+    if (!placed_) {
+        return;
+    }
+    if (!complete) {
+        fill(origin_x_, origin_x_ + rows, origin_y_, origin_y_ + cols);
+        return;
+    }
+    const int reach = int(std::ceil(range_));
+    for (const auto &region: changed) {
+        fill(region.x0 - reach, region.x1 + reach, region.y0 - reach, region.y1 + reach);
+    }
+}
+
+
+// Move the window so it is centered on (x, y). Rows and columns still inside the window keep their slot in the
+// ring buffer, so only the strips that come into view are computed, after catching up on changes to the site.
+void LocalMap::recenter(int x, int y) {
+    sync();
+    const int new_x = x - rows / 2;
+    const int new_y = y - cols / 2;
+    const int dx = new_x - origin_x_;
+    const int dy = new_y - origin_y_;
+    const int old_x = origin_x_;
+    const int old_y = origin_y_;
+    origin_x_ = new_x;
+    origin_y_ = new_y;
+
+    // Recompute everything if nothing of the old window is left
+    if (!placed_ || std::abs(dx) >= rows || std::abs(dy) >= cols) {
+        placed_ = true;
+        fill(new_x, new_x + rows, new_y, new_y + cols);
+        return;
+    }
+
+    // The rows that came into view, across the whole new window
+    if (dx > 0) {
+        fill(old_x + rows, new_x + rows, new_y, new_y + cols);
+    } else if (dx < 0) {
+        fill(new_x, old_x, new_y, new_y + cols);
+    }
+
+    // The columns that came into view, for the rows that were already in view
+    const int kept_x0 = std::max(new_x, old_x);
+    const int kept_x1 = std::min(new_x, old_x) + rows;
+    if (dy > 0) {
+        fill(kept_x0, kept_x1, old_y + cols, new_y + cols);
+    } else if (dy < 0) {
+        fill(kept_x0, kept_x1, new_y, old_y);
+    }
+}
+
+
+int LocalMap::originX() const {
+    return origin_x_;
+}
+
+
+int LocalMap::originY() const {
+    return origin_y_;
+}
+
+
+// Check whether a site coordinate is inside both the window and the site
+bool LocalMap::contains(int x, int y) const {
+    return placed_ && x >= origin_x_ && x < origin_x_ + rows && y >= origin_y_ && y < origin_y_ + cols &&
+           x >= 0 && x < site_rows && y >= 0 && y < site_cols;
+}
+
+
+// Get the clearance at a site coordinate
+double LocalMap::valAt(int x, int y) const {
+    if (!contains(x, y)) {
+        return -1;
+    }
+    return clearance_[slot(x, y)];
+}
+
+
+double LocalMap::valAt(const Coord &c) const {
+    return valAt(c.x, c.y);
+}
@@ -1,10 +1,15 @@
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
 #include "../include/Map.h"
 
 
 
 
 // This is the constructor of the Map class that initializes the Map object with the given number of rows and columns.
-Map::Map(int r, int c) : rows(r), cols(c) {
+// A deferred Map only records obstacles until its clearance field is first needed.
+Map::Map(int r, int c, bool deferred) : rows(r), cols(c), revision_(0), next_version_(1), built_(false) {
 // Ensure that the number of rows and columns are valid
     if (r < 1) {
         throw std::invalid_argument("rows must be greater than or equal to 1");
@@ -14,12 +19,7 @@ Map::Map(int r, int c) : rows(r), cols(c) {
     }
 
 
-// Reserve memory for the obstacles set
-    obstacles.reserve(rows * cols);
-
-
-// Resize the heat_map_ and the distance vectors to the appropriate size
-    heat_map_.resize(rows * cols);
+// Resize the distance vectors to the appropriate size
     vert_dist_.resize(rows);
     hor_dist_.resize(cols);
 
@@ -31,59 +31,197 @@ Map::Map(int r, int c) : rows(r), cols(c) {
     for (int j = 0; j < cols; j++) {
         hor_dist_[j] = j < cols / 2 ? j : cols - (j + 1);
     }
+
+
+// Split the heat map into square tiles, each guarded by its own lock once the heat map is built
+    tile_cols_ = (cols + tile_size - 1) / tile_size;
+
+
+// Allocate the heat map now, unless the build is deferred
+    if (!deferred) {
+        build();
+    }
+}
+
+
+// Runs fn(i) for every i in [0, n) on up to num_threads threads (0 means one per hardware thread).
+static void parallelFor(int n, int num_threads, const std::function<void(int)> &fn) {
+    if (num_threads <= 0) {
+        num_threads = int(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    num_threads = std::min(num_threads, n);
+    if (num_threads <= 1) {
+        for (int i = 0; i < n; i++) {
+            fn(i);
+        }
+        return;
+    }
+
+    // Each worker claims the next unprocessed index until none are left
+    std::atomic<int> next(0);
+    std::vector<std::thread> workers;
+    workers.reserve(num_threads);
+    for (int t = 0; t < num_threads; t++) {
+        workers.emplace_back([&]() {
+            for (int i = next++; i < n; i = next++) {
+                fn(i);
+            }
+        });
+    }
+    for (auto &worker: workers) {
+        worker.join();
+    }
+}
+
+
+// Get the lock of the tile containing the given (x, y) coordinates.
+std::mutex &Map::tileLock(int x, int y) {
+    return tile_locks_[(x / tile_size) * tile_cols_ + y / tile_size];
+}
+
+
+// Set the clearance of a cell, keeping the single precision copy in step.
+void Map::setClearance(int key, double value) {
+    clearance_[key] = value;
+    clearance_f_[key] = float(value);
+}
+
+
+// Check whether the given item refers to an object still in the map, and not to a place the object has moved from.
+// The placement is read without locking the obstacles, so threads updating different tiles don't contend here.
+bool Map::isLive(const MapItem &item) const {
+    return item.placement->load(std::memory_order_acquire) == item.version;
+}
+
+
+// Remove every entry of an object from the heap of a heat map cell.
+static void purge(std::vector<MapItem> &heap, const Object::Ptr &object) {
+    auto end = std::remove_if(heap.begin(), heap.end(), [&](const MapItem &item) { return item.obj == object; });
+    if (end != heap.end()) {
+        heap.erase(end, heap.end());
+        std::make_heap(heap.begin(), heap.end(), MapComp());
+    }
+}
+
+
+// Entries of objects that were moved or removed by another thread while this cell was being visited may be left in
+// the heap, they are dropped once they reach the top.
+void Map::refresh(int key) {
+    auto &heap = heat_map_[key];
+    while (!heap.empty() && !isLive(heap.front())) {
+        std::pop_heap(heap.begin(), heap.end(), MapComp());
+        heap.pop_back();
+    }
+    setClearance(key, heap.empty() ? std::min(vert_dist_[key / cols], hor_dist_[key % cols]) : heap.front().dist);
 }
 
 
 // This static function returns a shared pointer to a newly created Map object with the given number of rows and columns.
-Map::Ptr Map::createMap(int r, int c) {
-    return std::make_shared<Map>(r, c);
+Map::Ptr Map::createMap(int r, int c, bool deferred) {
+    return std::make_shared<Map>(r, c, deferred);
 }
 
 
-// This function returns the number of objects in the obstacles set.
-int Map::numObjects() {
-    return int(obstacles.size());
+// Every point of an object is within its extent of its coordinate.
+Region Map::footprint(const Object::Ptr &object) const {
+    const int e = int(std::ceil(object->extent()));
+    return {std::max(0, object->x() - e), std::min(rows, object->x() + e + 1),
+            std::max(0, object->y() - e), std::min(cols, object->y() + e + 1)};
 }
 
 
-/**
-* Adds an object to the map.
-*
-* @param object A shared pointer to the object to add.
-* @return true if the object was added successfully, false otherwise.
-*/
-bool Map::addObject(const Object::Ptr &object) {
-    const int c_x = object->x();
-    const int c_y = object->y();
-    const double c_r = object->radius;
+// Pack the coordinates of an index bucket into one key
+static uint64_t bucketKey(int bx, int by) {
+    return (uint64_t(uint32_t(bx)) << 32) | uint32_t(by);
+}
 
 
-    // Check if object location is within the map boundaries.
-    if (c_x < 0 || c_x > rows - 1 || c_y < 0 || c_y > cols - 1) {
-        std::cerr << "Object location is out of bounds...\n";
-        return false;
+// Add the object to, or remove it from, every bucket of the region, and keep the region in the change log
+void Map::reindex(const Object::Ptr &object, const Region &region, bool add) {
+    for (int bx = region.x0 / bucket_size; bx <= (region.x1 - 1) / bucket_size; bx++) {
+        for (int by = region.y0 / bucket_size; by <= (region.y1 - 1) / bucket_size; by++) {
+            if (add) {
+                index_[bucketKey(bx, by)].push_back(object);
+                continue;
+            }
+            auto iter = index_.find(bucketKey(bx, by));
+            if (iter == index_.end()) {
+                continue;
+            }
+            auto &objects = iter->second;
+            auto pos = std::find(objects.begin(), objects.end(), object);
+            if (pos != objects.end()) {
+                *pos = objects.back();
+                objects.pop_back();
+            }
+            if (objects.empty()) {
+                index_.erase(iter);
+            }
+        }
     }
 
+    changes_.push_front(region);
+    if (changes_.size() > change_log_size) {
+        changes_.pop_back();
+    }
+    revision_++;
+}
 
-        // Check if object has positive radius.
-    else if (c_r <= 0) {
-        std::cerr << "Object must have positive radius...\n";
-        return false;
+
+// An object lying within the map covers its own coordinate, which is enough to reach every cell it influences.
+// An object crossing the edge may cover several separate parts of the map, so every cell of its footprint the
+// object influences is a seed.
+std::vector<Coord> Map::seedsOf(const Object::Ptr &object) const {
+    const double e = object->extent();
+    const int x = object->x();
+    const int y = object->y();
+    if (x - e >= 0 && x + e <= rows - 1 && y - e >= 0 && y + e <= cols - 1) {
+        return {Coord(x, y)};
+    }
+    std::vector<Coord> seeds;
+    for (int i = std::max(0, int(std::floor(x - e))); i <= std::min(rows - 1, int(std::ceil(x + e))); i++) {
+        for (int j = std::max(0, int(std::floor(y - e))); j <= std::min(cols - 1, int(std::ceil(y + e))); j++) {
+            if (object->clearance(Coord(i, j)) <= std::min(vert_dist_[i], hor_dist_[j])) {
+                seeds.emplace_back(i, j);
+            }
+        }
     }
+    return seeds;
+}
 
 
-    // Add the object to the map.
-    obstacles.insert(object);
+// A cell's distance from an object is at least its distance from the object's coordinate minus the object's extent,
+// and a cell is only influenced if that is within the cell's distance from the edge. This bounds the influenced
+// cells to a box reaching about halfway from the object's coordinate to each edge of the map.
+Region Map::influenceBox(const Object::Ptr &object) const {
+    const double e = object->extent();
+    return {std::max(0, int(std::floor((object->x() - e) / 2))),
+            std::min(rows, int(std::ceil((rows - 1 + object->x() + e) / 2)) + 1),
+            std::max(0, int(std::floor((object->y() - e) / 2))),
+            std::min(cols, int(std::ceil((cols - 1 + object->y() + e) / 2)) + 1)};
+}
 
 
+// Calls fn(key, dist) for every cell of the box whose dist(cell) is within its distance from the edge, found by BFS
+// from the seeds. The visited array only covers the box, not the whole map.
+template<typename D, typename F>
+void Map::forEachWithin(const std::vector<Coord> &seeds, const Region &box, D dist, F fn) {
     // Create a queue for BFS.
     std::queue<Coord> q;
-    q.emplace(c_x, c_y);
 
 
-    // Create a visited array to keep track of visited cells.
-    std::vector<bool> visited(rows * cols, false);
-    visited[c_x * cols + c_y] = true;
+    // Create a visited array to keep track of visited cells of the box.
+    const int box_cols = box.y1 - box.y0;
+    std::vector<bool> visited(std::max(0, (box.x1 - box.x0) * box_cols), false);
+    auto inBox = [&](const Coord &c) {
+        return c.x >= box.x0 && c.x < box.x1 && c.y >= box.y0 && c.y < box.y1;
+    };
+    for (const auto &seed: seeds) {
+        if (inBox(seed) && !visited[(seed.x - box.x0) * box_cols + seed.y - box.y0]) {
+            visited[(seed.x - box.x0) * box_cols + seed.y - box.y0] = true;
+            q.push(seed);
+        }
+    }
 
 
     // Traverse the map using BFS.
@@ -92,18 +230,21 @@ bool Map::addObject(const Object::Ptr &object) {
         q.pop();
 
 
-        // Calculate the distance between the object and the current cell.
-        const double dist = std::max(0., object->dist(cur_c) - c_r);
+        // Calculate the distance between the edge of the object and the current cell.
+        const double d = dist(cur_c);
 
 
         // Check if the distance is within the range of influence of the object.
-        if (dist <= std::min(vert_dist_[cur_c.x], hor_dist_[cur_c.y])) {
-            heat_map_[cur_c.x * cols + cur_c.y].emplace(dist, object);
+        if (d <= std::min(vert_dist_[cur_c.x], hor_dist_[cur_c.y])) {
+            fn(cur_c.x * cols + cur_c.y, d);
 
 
             // Visit all the neighboring cells.
             for (const auto &next_c: cur_c.surrounding(rows, cols)) {
-                int next_key = next_c.x * cols + next_c.y;
+                if (!inBox(next_c)) {
+                    continue;
+                }
+                int next_key = (next_c.x - box.x0) * box_cols + next_c.y - box.y0;
                 if (!visited[next_key]) {
                     visited[next_key] = true;
                     q.push(next_c);
@@ -111,6 +252,143 @@ bool Map::addObject(const Object::Ptr &object) {
             }
         }
     }
+}
+
+
+// Calls fn(key, dist) for every cell within the object's range of influence, found by BFS from the object's seeds.
+template<typename F>
+void Map::forEachInfluenced(const Object::Ptr &object, F fn) {
+    forEachWithin(seedsOf(object), influenceBox(object),
+                  [&](const Coord &c) { return object->clearance(c); }, fn);
+}
+
+
+// Build the heat map of every recorded obstacle in one bulk pass, if it hasn't been built yet.
+void Map::build() {
+    if (built_) {
+        return;
+    }
+    std::lock_guard<std::mutex> build_lock(build_lock_);
+    if (built_) {
+        return;
+    }
+
+    std::vector<std::pair<Object::Ptr, Placement>> objects;
+    {
+        std::shared_lock<std::shared_mutex> lock(obstacles_lock_);
+        objects.assign(obstacles.begin(), obstacles.end());
+    }
+    tile_locks_ = std::vector<std::mutex>(((rows + tile_size - 1) / tile_size) * tile_cols_);
+    heat_map_.resize(rows * cols);
+    clearance_.resize(rows * cols);
+    clearance_f_.resize(rows * cols);
+
+    // Without obstacles the clearance is the distance from the edge, which is quicker to fill on this thread than to
+    // start any others for, so creating an empty map stays cheap
+    if (objects.empty()) {
+        for (int i = 0; i < rows; i++) {
+            for (int j = 0; j < cols; j++) {
+                setClearance(i * cols + j, std::min(vert_dist_[i], hor_dist_[j]));
+            }
+        }
+        built_ = true;
+        return;
+    }
+
+    // Collect the entries of every cell first, so each heap is built once instead of pushed into repeatedly
+    std::vector<std::vector<MapItem>> items(rows * cols);
+    parallelFor(int(objects.size()), 0, [&](int i) {
+        forEachInfluenced(objects[i].first, [&](int key, double dist) {
+            std::lock_guard<std::mutex> lock(tileLock(key / cols, key % cols));
+            items[key].emplace_back(dist, objects[i].first, objects[i].second, objects[i].second->load());
+        });
+    });
+
+    // Heapify each cell and record its clearance, with no obstacles it is the distance from the edge
+    parallelFor(rows, 0, [&](int i) {
+        for (int j = 0; j < cols; j++) {
+            const int key = i * cols + j;
+            if (!items[key].empty()) {
+                heat_map_[key] = std::move(items[key]);
+                std::make_heap(heat_map_[key].begin(), heat_map_[key].end(), MapComp());
+            }
+            setClearance(key, heat_map_[key].empty() ? std::min(vert_dist_[i], hor_dist_[j]) : heat_map_[key].front().dist);
+        }
+    });
+
+    built_ = true;
+}
+
+
+// This function returns the number of objects in the obstacles set.
+int Map::numObjects() {
+    std::shared_lock<std::shared_mutex> lock(obstacles_lock_);
+    return int(obstacles.size());
+}
+
+
+/**
+* Adds an object to the map.
+*
+* @param object A shared pointer to the object to add.
+* @return true if the object was added successfully, false otherwise.
+*/
+bool Map::addObject(const Object::Ptr &object) {
+    // Check if object has a positive radius, or a well formed shape.
+    if (!object->valid()) {
+        std::cerr << "Object must have positive radius or a well formed shape...\n";
+        return false;
+    }
+
+
+        // Check if at least part of the object is within the map boundaries.
+    else if (seedsOf(object).empty()) {
+        std::cerr << "Object location is out of bounds...\n";
+        return false;
+    }
+
+
+    // Add the object to the map, an object added twice keeps its placement.
+    Placement placement;
+    uint64_t version;
+    bool checkpoint_due = false;
+    {
+        std::unique_lock<std::shared_mutex> lock(obstacles_lock_);
+        auto &entry = obstacles[object];
+        if (entry == nullptr) {
+            entry = std::make_shared<std::atomic<uint64_t>>(next_version_++);
+            reindex(object, footprint(object), true);
+
+            // Log the mutation while the obstacles are still locked, so the journal holds the mutations of
+            // concurrent threads in the order they changed the map.
+            checkpoint_due = journal_ != nullptr && journal_->logAdd(object);
+        }
+        placement = entry;
+        version = placement->load();
+    }
+
+
+    // The checkpoint locks the obstacles itself.
+    if (checkpoint_due) {
+        checkpoint();
+    }
+
+
+    // A map whose build is deferred only records the object for now.
+    if (!built_) {
+        return true;
+    }
+
+
+    // Add the object to the heat map of every cell it influences.
+    forEachInfluenced(object, [&](int key, double dist) {
+        // Only the tile owning this cell is locked, other threads may update the rest of the map.
+        std::lock_guard<std::mutex> lock(tileLock(key / cols, key % cols));
+        auto &heap = heat_map_[key];
+        heap.emplace_back(dist, object, placement, version);
+        std::push_heap(heap.begin(), heap.end(), MapComp());
+        refresh(key);
+    });
 
 
     return true;
@@ -138,90 +416,242 @@ Object::Ptr Map::addObject(int x, int y, double r) {
 
 // Remove the given object from the map. Returns true if successful, false otherwise.
 bool Map::removeObject(const Object::Ptr &object) {
-    auto iter = obstacles.find(object);
-    if (iter == obstacles.end()) {  // object not found in the map
-        std::cerr << "This map does not contain that object...\n";
-        return false;
-    }
+    bool checkpoint_due;
+    {
+        std::unique_lock<std::shared_mutex> lock(obstacles_lock_);
+        auto iter = obstacles.find(object);
+        if (iter == obstacles.end()) {  // object not found in the map
+            std::cerr << "This map does not contain that object...\n";
+            return false;
+        }
 
 
-    obstacles.erase(iter);  // remove the object from the map
+        iter->second->store(0, std::memory_order_release);  // retire the object's entries
+        obstacles.erase(iter);  // remove the object from the map
+        reindex(object, footprint(object), false);
+        checkpoint_due = journal_ != nullptr && journal_->logRemove(object);
+    }
 
 
-    const int c_x = object->x();
-    const int c_y = object->y();
-    const double c_r = object->radius;
+    if (checkpoint_due) {
+        checkpoint();
+    }
 
 
-    // update the heat map
-    std::queue<Coord> q;
-    q.emplace(c_x, c_y);
+    // A map whose build is deferred has no heat map to update yet.
+    if (!built_) {
+        return true;
+    }
 
 
-    std::vector<bool> visited(rows * cols, false);
-    visited[c_x * cols + c_y] = true;
+    // update the heat map, removing the object's entries from every cell it influenced
+    forEachInfluenced(object, [&](int key, double) {
+        std::lock_guard<std::mutex> lock(tileLock(key / cols, key % cols));
+        purge(heat_map_[key], object);
+        refresh(key);
+    });
 
 
-    while (!q.empty()) {
-        const Coord cur_c = q.front();
-        q.pop();
+    return true;
+}
 
+// Remove the object with the given coordinates and radius from the map. Returns the removed object if successful, nullptr otherwise.
+Object::Ptr Map::removeObject(int x, int y, double r) {
+    Object::Ptr to_delete = nullptr;
+    {
+        std::shared_lock<std::shared_mutex> lock(obstacles_lock_);
+        for (const auto &entry: obstacles) {
+            const auto &obj = entry.first;
+            if (obj->x() == x && obj->y() == y && std::fabs(obj->radius - r) <= 0.000001) {
+                to_delete = obj;
+                break;
+            }
+        }
+    }
+    removeObject(to_delete);
+    return to_delete;
+}
 
-        const double dist = std::max(0., object->dist(cur_c) - c_r);
 
+// Move the given object so its coordinate is at (x, y). Every cell's distance to the object changes, so the cells
+// influenced before or after the move are visited in a single BFS, rather than one to remove the object and one to
+// add it back, that replaces each cell's old entry with the new one.
+bool Map::moveObject(const Object::Ptr &object, int x, int y) {
+    // Move the object and give its new placement a new version, which retires its old entries.
+    int dx, dy;
+    Placement placement;
+    uint64_t version;
+    Region old_box{};
+    std::vector<Coord> seeds;
+    bool checkpoint_due;
+    {
+        std::unique_lock<std::shared_mutex> lock(obstacles_lock_);
+        auto iter = obstacles.find(object);
+        if (iter == obstacles.end()) {
+            std::cerr << "This map does not contain that object...\n";
+            return false;
+        }
+        dx = x - object->x();
+        dy = y - object->y();
+        if (dx == 0 && dy == 0) {
+            return true;
+        }
+        old_box = influenceBox(object);
+        seeds = seedsOf(object);
+        const Region old_footprint = footprint(object);
+        object->translate(dx, dy);
+
+        // The object may move partly off the map, but not entirely.
+        auto new_seeds = seedsOf(object);
+        if (new_seeds.empty()) {
+            object->translate(-dx, -dy);
+            std::cerr << "Object location is out of bounds...\n";
+            return false;
+        }
+        seeds.insert(seeds.end(), new_seeds.begin(), new_seeds.end());
+        reindex(object, old_footprint, false);
+        reindex(object, footprint(object), true);
+        placement = iter->second;
+        version = next_version_++;
+        placement->store(version, std::memory_order_release);
+        checkpoint_due = journal_ != nullptr && journal_->logMove(object);
+    }
 
-        if (dist <= std::min(vert_dist_[cur_c.x], hor_dist_[cur_c.y])) {
-            auto &pq = heat_map_[cur_c.x * cols + cur_c.y];
 
+    if (checkpoint_due) {
+        checkpoint();
+    }
 
-            // remove all entries in the priority queue that refer to the removed object
-            while (!pq.empty() && obstacles.find(pq.top().obj) == obstacles.end()) {
-                pq.pop();
-            }
 
+    // A map whose build is deferred has no heat map to update yet.
+    if (!built_) {
+        return true;
+    }
 
-            // update the heat map for neighboring cells
-            for (const auto &next_c: cur_c.surrounding(rows, cols)) {
-                int next_key = next_c.x * cols + next_c.y;
-                if (!visited[next_key]) {
-                    visited[next_key] = true;
-                    q.push(next_c);
-                }
-            }
+
+    // The object's old distance to a cell is its new distance to the cell shifted by the move.
+    const Region new_box = influenceBox(object);
+    const Region box = {std::min(old_box.x0, new_box.x0), std::max(old_box.x1, new_box.x1),
+                        std::min(old_box.y0, new_box.y0), std::max(old_box.y1, new_box.y1)};
+    auto dist = [&](const Coord &c) {
+        return std::min(object->clearance(c), object->clearance(Coord(c.x + dx, c.y + dy)));
+    };
+    forEachWithin(seeds, box, dist, [&](int key, double) {
+        const int i = key / cols;
+        const int j = key % cols;
+        const double edge = std::min(vert_dist_[i], hor_dist_[j]);
+        const double new_dist = object->clearance(Coord(i, j));
+
+        // The old entry is replaced, not left behind for later, so cells keep one entry per obstacle near them.
+        std::lock_guard<std::mutex> lock(tileLock(i, j));
+        auto &heap = heat_map_[key];
+        purge(heap, object);
+        if (new_dist <= edge) {
+            heap.emplace_back(new_dist, object, placement, version);
+            std::push_heap(heap.begin(), heap.end(), MapComp());
         }
-    }
+        refresh(key);
+    });
 
 
     return true;
 }
 
 
-// Remove the object with the given coordinates and radius from the map. Returns the removed object if successful, nullptr otherwise.
-Object::Ptr Map::removeObject(int x, int y, double r) {
-    Object::Ptr to_delete = nullptr;
-    for (const auto &obj: obstacles) {
-        if (obj->x() == x && obj->y() == y && std::fabs(obj->radius - r) <= 0.000001) {
-            to_delete = obj;
-            break;
+// Move all the given objects, spreading the work over num_threads threads.
+int Map::moveObjects(const std::vector<std::pair<Object::Ptr, Coord>> &moves, int num_threads) {
+    std::atomic<int> moved(0);
+    parallelFor(int(moves.size()), num_threads, [&](int i) {
+        if (moveObject(moves[i].first, moves[i].second.x, moves[i].second.y)) {
+            moved++;
         }
-    }
-    removeObject(to_delete);
-    return to_delete;
+    });
+    return moved;
+}
+
+
+// Add all the given objects to the map, spreading the work over num_threads threads.
+// Objects whose regions of influence overlap only contend on the tiles they share.
+int Map::addObjects(const std::vector<Object::Ptr> &objects, int num_threads) {
+    std::atomic<int> added(0);
+    parallelFor(int(objects.size()), num_threads, [&](int i) {
+        if (addObject(objects[i])) {
+            added++;
+        }
+    });
+    return added;
+}
+
+
+// Remove all the given objects from the map, spreading the work over num_threads threads.
+int Map::removeObjects(const std::vector<Object::Ptr> &objects, int num_threads) {
+    std::atomic<int> removed(0);
+    parallelFor(int(objects.size()), num_threads, [&](int i) {
+        if (removeObject(objects[i])) {
+            removed++;
+        }
+    });
+    return removed;
 }
 
 
 // Remove all objects from the map.
 void Map::clearMap() {
-    auto temp = obstacles;
-    for (const auto & obs : temp) {
-        removeObject(obs);
-    }
+    removeObjects(getObstacles());
 }
 
 
 // Get a vector of shared pointers to all objects in the map.
 [[nodiscard]] std::vector<Object::Ptr> Map::getObstacles() const {
-    return {obstacles.begin(), obstacles.end()};
+    std::shared_lock<std::shared_mutex> lock(obstacles_lock_);
+    std::vector<Object::Ptr> objects;
+    objects.reserve(obstacles.size());
+    for (const auto &entry: obstacles) {
+        objects.push_back(entry.first);
+    }
+    return objects;
+}
+
+
+// Get the obstacles listed in the index buckets overlapping the region, each once.
+std::vector<Object::Ptr> Map::obstaclesIn(const Region &region) const {
+    std::vector<Object::Ptr> objects;
+    const Region r = {std::max(0, region.x0), std::min(rows, region.x1), std::max(0, region.y0), std::min(cols, region.y1)};
+    if (r.x0 >= r.x1 || r.y0 >= r.y1) {
+        return objects;
+    }
+    std::shared_lock<std::shared_mutex> lock(obstacles_lock_);
+    for (int bx = r.x0 / bucket_size; bx <= (r.x1 - 1) / bucket_size; bx++) {
+        for (int by = r.y0 / bucket_size; by <= (r.y1 - 1) / bucket_size; by++) {
+            auto iter = index_.find(bucketKey(bx, by));
+            if (iter != index_.end()) {
+                objects.insert(objects.end(), iter->second.begin(), iter->second.end());
+            }
+        }
+    }
+    std::sort(objects.begin(), objects.end());
+    objects.erase(std::unique(objects.begin(), objects.end()), objects.end());
+    return objects;
+}
+
+
+// Get the number of changes made to the obstacles so far.
+uint64_t Map::revision() const {
+    std::shared_lock<std::shared_mutex> lock(obstacles_lock_);
+    return revision_;
+}
+
+
+// Append the footprints changed since the given revision, the log holds the most recent ones first.
+bool Map::changesSince(uint64_t &revision, std::vector<Region> &regions) const {
+    std::shared_lock<std::shared_mutex> lock(obstacles_lock_);
+    const uint64_t missed = revision_ - revision;
+    revision = revision_;
+    if (missed > changes_.size()) {
+        return false;
+    }
+    regions.insert(regions.end(), changes_.begin(), changes_.begin() + std::ptrdiff_t(missed));
+    return true;
 }
 
 
@@ -236,14 +666,69 @@ double Map::valAt(int x, int y) {
     if (x < 0 || x >= rows || y < 0 || y >= cols) {
         return -1;
     }
-    auto &pq = heat_map_[x * cols + y];
-    return pq.empty() ? std::min(vert_dist_[x], hor_dist_[y]) : pq.top().dist;
+    if (!built_) {
+        build();
+    }
+    return clearance_[x * cols + y];
+}
+
+
+// Bilinearly interpolates a rows x cols grid at n positions, and its gradient if WithGrad.
+// The outputs can't alias the grid and the loop has no branches, so the compiler vectorizes it.
+template<bool WithGrad>
+static void interpolate(const float *__restrict grid, int rows, int cols, const float *xs, const float *ys,
+                        std::size_t n, float *__restrict out, float *__restrict grad_x, float *__restrict grad_y) {
+    const float max_x = float(rows - 1);
+    const float max_y = float(cols - 1);
+    const int last_x = std::max(rows - 2, 0);
+    const int last_y = std::max(cols - 2, 0);
+    const int step_x = rows > 1 ? cols : 0;
+    const int step_y = cols > 1 ? 1 : 0;
+
+    for (std::size_t i = 0; i < n; i++) {
+        // Clamp the position to the map and split it into a cell and an offset within the cell
+        const float x = std::min(std::max(xs[i], 0.f), max_x);
+        const float y = std::min(std::max(ys[i], 0.f), max_y);
+        const int x0 = std::min(int(x), last_x);
+        const int y0 = std::min(int(y), last_y);
+        const float fx = x - float(x0);
+        const float fy = y - float(y0);
+
+        const int k = x0 * cols + y0;
+        const float v00 = grid[k];
+        const float v01 = grid[k + step_y];
+        const float v10 = grid[k + step_x];
+        const float v11 = grid[k + step_x + step_y];
+
+        const float top = v00 + fy * (v01 - v00);
+        const float bottom = v10 + fy * (v11 - v10);
+        out[i] = top + fx * (bottom - top);
+
+        if constexpr (WithGrad) {
+            grad_x[i] = bottom - top;
+            grad_y[i] = (1.f - fx) * (v01 - v00) + fx * (v11 - v10);
+        }
+    }
+}
+
+
+// Sample the clearance at continuous positions by bilinear interpolation between the four surrounding cells, from
+// the single precision copy of the clearance grid.
+void Map::sampleClearance(const float *xs, const float *ys, std::size_t n, float *out,
+                          float *grad_x, float *grad_y) {
+    build();
+    if (grad_x != nullptr && grad_y != nullptr) {
+        interpolate<true>(clearance_f_.data(), rows, cols, xs, ys, n, out, grad_x, grad_y);
+    } else {
+        interpolate<false>(clearance_f_.data(), rows, cols, xs, ys, n, out, nullptr, nullptr);
+    }
 }
 
 
 // This function generates a CV Mat image representing the current state of the Map
 // If show_heat_map is set to true, the heat map will be overlaid on top of the obstacles
 cv::Mat Map::display(bool show_heat_map) {
+    build();
 
 
     // Create an empty CV Mat with the dimensions of the Map
@@ -263,9 +748,9 @@ cv::Mat Map::display(bool show_heat_map) {
     }
 
 
-    // Draw obstacles as blue circles
-    for (const auto &obj: obstacles) {
-        cv::circle(image, {obj->y(), obj->x()}, int(obj->radius), cv::Vec3b(255, 0, 0), -1);
+    // Draw obstacles in blue
+    for (const auto &entry: obstacles) {
+        entry.first->draw(image, cv::Vec3b(255, 0, 0));
     }
 
 
@@ -292,9 +777,18 @@ bool Map::save(const std::string &filename) {
     }
     // Write the dimensions of the map to the file
     outfile << rows << " " << cols << std::endl;
-    // Write the obstacle information to the file
-    for (const auto &obj: obstacles) {
-        outfile << obj->x() << " " << obj->y() << " " << std::setprecision(10) << obj->radius << std::endl;
+    // Write the obstacle information to the file, discs as "x y radius" and other shapes as "name params..."
+    outfile << std::setprecision(10);
+    for (const auto &entry: obstacles) {
+        const auto &obj = entry.first;
+        if (obj->shape() != Shape::Disc) {
+            outfile << Object::shapeName(obj->shape()) << " ";
+        }
+        const auto p = obj->params();
+        for (size_t i = 0; i < p.size(); i++) {
+            outfile << (i ? " " : "") << p[i];
+        }
+        outfile << std::endl;
     }
     return true;
 }
@@ -311,17 +805,86 @@ Map::Ptr Map::load(const std::string &filename) {
     // Read in the dimensions of the map
     int r, c;
     infile >> r >> c;
-    // Create a new map with the given dimensions
-    auto new_map = Map::createMap(r, c);
+    // Create a new map with the given dimensions, its heat map is built in one pass once it's first queried
+    auto new_map = Map::createMap(r, c, true);
     // Read in obstacle information and add objects to the map
     std::string line;
     while (std::getline(infile, line)) {
         std::istringstream iss(line);
-        int x, y;
-        double radius;
-        if (iss >> x >> y >> radius) {
-            new_map->addObject(x, y, radius);
+        std::string name;
+        Shape shape;
+        if (!(iss >> name)) {
+            continue;
+        }
+        if (Object::parseShape(name, shape)) {
+            // A named shape followed by its parameters
+            std::vector<double> p;
+            double v;
+            while (iss >> v) {
+                p.push_back(v);
+            }
+            auto obj = Object::fromParams(shape, p);
+            if (obj == nullptr) {
+                std::cerr << "Skipping malformed " << name << " in " << filename << "\n";
+                continue;
+            }
+            new_map->addObject(obj);
+        } else {
+            // A disc written as x y radius
+            std::istringstream disc(line);
+            int x, y;
+            double radius;
+            if (disc >> x >> y >> radius) {
+                new_map->addObject(x, y, radius);
+            }
+        }
+    }
+    return new_map;
+}
+
+
+// Start journaling mutations to the given file, beginning with a checkpoint of the current obstacles
+bool Map::openJournal(const std::string &filename, int checkpoint_interval) {
+    auto journal = Journal::create(filename, rows, cols, checkpoint_interval);
+    if (journal == nullptr) {
+        return false;
+    }
+    journal_ = journal;
+    return checkpoint();
+}
+
+
+// Write a checkpoint of the current obstacles next to the journal
+bool Map::checkpoint() {
+    if (journal_ == nullptr) {
+        std::cerr << "This map has no journal to checkpoint...\n";
+        return false;
+    }
+    // Objects can't move while the checkpoint reads their geometry
+    std::shared_lock<std::shared_mutex> lock(obstacles_lock_);
+    return journal_->checkpoint([this]() {
+        std::vector<Object::Ptr> objects;
+        objects.reserve(obstacles.size());
+        for (const auto &entry: obstacles) {
+            objects.push_back(entry.first);
         }
+        return objects;
+    });
+}
+
+
+// Recover a map from its journal and return a pointer to it, its heat map is built once it's first queried
+Map::Ptr Map::recover(const std::string &filename, int checkpoint_interval) {
+    int r, c;
+    std::vector<Object::Ptr> objects;
+    auto journal = Journal::recover(filename, checkpoint_interval, r, c, objects);
+    if (journal == nullptr) {
+        return nullptr;
+    }
+    auto new_map = Map::createMap(r, c, true);
+    for (const auto &obj: objects) {
+        new_map->addObject(obj);
     }
+    new_map->journal_ = journal;
     return new_map;
 }
@@ -3,7 +3,11 @@
 //
 
 
+#include <opencv2/imgproc.hpp>
+
+
 #include "../include/Object.h"
+#include "../include/Shapes.h"
 
 
 // Calculate the Euclidean distance between two coordinates
@@ -46,6 +50,103 @@ Object::Ptr Object::createObject(int x, int y, double radius) {
 }
 
 
+// Create an Object of the given shape from its parameters
+Object::Ptr Object::fromParams(Shape shape, const std::vector<double> &p) {
+    switch (shape) {
+        case Shape::Disc:
+            if (p.size() != 3) return nullptr;
+            return createObject(int(p[0]), int(p[1]), p[2]);
+        case Shape::Segment:
+            if (p.size() != 5) return nullptr;
+            return Segment::create(int(p[0]), int(p[1]), int(p[2]), int(p[3]), p[4]);
+        case Shape::Box:
+            if (p.size() != 4) return nullptr;
+            return Box::create(int(p[0]), int(p[1]), int(p[2]), int(p[3]));
+        case Shape::Polygon: {
+            if (p.size() < 6 || p.size() % 2 != 0) return nullptr;
+            std::vector<Coord> vertices;
+            vertices.reserve(p.size() / 2);
+            for (size_t i = 0; i < p.size(); i += 2) {
+                vertices.emplace_back(int(p[i]), int(p[i + 1]));
+            }
+            return Polygon::create(vertices);
+        }
+    }
+    return nullptr;
+}
+
+
+// Return the name of a shape, as used in map files
+std::string Object::shapeName(Shape shape) {
+    switch (shape) {
+        case Shape::Disc:
+            return "disc";
+        case Shape::Segment:
+            return "segment";
+        case Shape::Box:
+            return "box";
+        case Shape::Polygon:
+            return "polygon";
+    }
+    return "";
+}
+
+
+// Parse the name of a shape
+bool Object::parseShape(const std::string &name, Shape &shape) {
+    for (auto s: {Shape::Disc, Shape::Segment, Shape::Box, Shape::Polygon}) {
+        if (name == shapeName(s)) {
+            shape = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// A plain Object is a disc
+Shape Object::shape() const {
+    return Shape::Disc;
+}
+
+
+// A disc is described by its center and radius
+std::vector<double> Object::params() const {
+    return {double(coord.x), double(coord.y), radius};
+}
+
+
+// A disc needs a positive radius
+bool Object::valid() const {
+    return radius > 0;
+}
+
+
+// Distance from the edge of the disc
+double Object::clearance(const Coord &c) const {
+    return std::max(0., coord.dist(c) - radius);
+}
+
+
+// Move the disc's center
+void Object::translate(int dx, int dy) {
+    coord.x += dx;
+    coord.y += dy;
+}
+
+
+// A disc extends as far as its radius
+double Object::extent() const {
+    return radius;
+}
+
+
+// Draw the disc as a filled circle
+void Object::draw(cv::Mat &image, const cv::Vec3b &color) const {
+    cv::circle(image, {coord.y, coord.x}, int(radius), color, -1);
+}
+
+
 // Calculate the distance between an Object's coordinate and a given coordinate
 double Object::dist(const Coord& c) const {
     return coord.dist(c);
@@ -0,0 +1,215 @@
+#include <stdexcept>
+
+
+#include "../include/Path.h"
+
+
+// Steps in each of the 8 directions, a run's direction is its index in these tables
+static const int STEP_X[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+static const int STEP_Y[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+static const int MAX_RUN = 32;
+static const char PATH_MAGIC[4] = {'R', 'N', 'P', '1'};
+
+
+// Find the direction of a step between neighboring cells, or -1 if the cells aren't neighbors
+static int direction(const Coord &from, const Coord &to) {
+    const int dx = to.x - from.x;
+    const int dy = to.y - from.y;
+    for (int d = 0; d < 8; d++) {
+        if (STEP_X[d] == dx && STEP_Y[d] == dy) {
+            return d;
+        }
+    }
+    return -1;
+}
+
+
+// Check whether a robot of the given radius can drive in a straight line between two cells, following the cells of
+// Bresenham's line between them
+static bool lineOfSight(const Map::Ptr &map, const Coord &from, const Coord &to, double radius) {
+    const int dx = std::abs(to.x - from.x);
+    const int dy = -std::abs(to.y - from.y);
+    const int sx = from.x < to.x ? 1 : -1;
+    const int sy = from.y < to.y ? 1 : -1;
+    int x = from.x;
+    int y = from.y;
+    int err = dx + dy;
+    while (true) {
+        if (map->valAt(x, y) < radius) {
+            return false;
+        }
+        if (x == to.x && y == to.y) {
+            return true;
+        }
+        const int e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            x += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            y += sy;
+        }
+    }
+}
+
+
+CompactPath::iterator::iterator(const std::vector<uint8_t> *runs, std::size_t index, Coord coord)
+        : runs_(runs), run_(0), taken_(0), index_(index), coord_(coord) {}
+
+
+// Take the next step of the current run, moving on to the next run when it is used up
+CompactPath::iterator &CompactPath::iterator::operator++() {
+    index_++;
+    if (run_ >= runs_->size()) {
+        return *this;
+    }
+    const uint8_t run = (*runs_)[run_];
+    coord_.x += STEP_X[run >> 5];
+    coord_.y += STEP_Y[run >> 5];
+    if (++taken_ == (run & 31) + 1) {
+        run_++;
+        taken_ = 0;
+    }
+    return *this;
+}
+
+
+CompactPath::iterator CompactPath::iterator::operator++(int) {
+    iterator before = *this;
+    ++*this;
+    return before;
+}
+
+
+CompactPath::CompactPath() : origin_(0, 0), size_(0) {}
+
+
+// Encode a path, merging consecutive steps in the same direction into runs
+CompactPath::CompactPath(const std::vector<Coord> &path) : origin_(0, 0), size_(path.size()) {
+    if (path.empty()) {
+        return;
+    }
+    origin_ = path.front();
+    int dir = -1;
+    int length = 0;
+    for (std::size_t i = 1; i < path.size(); i++) {
+        const int d = direction(path[i - 1], path[i]);
+        if (d == -1) {
+            throw std::invalid_argument("Path cells must be neighbors");
+        }
+        if (d != dir || length == MAX_RUN) {
+            if (length > 0) {
+                runs_.push_back(uint8_t(dir << 5 | (length - 1)));
+            }
+            dir = d;
+            length = 0;
+        }
+        length++;
+    }
+    if (length > 0) {
+        runs_.push_back(uint8_t(dir << 5 | (length - 1)));
+    }
+    runs_.shrink_to_fit();
+}
+
+
+CompactPath::iterator CompactPath::begin() const {
+    return {&runs_, 0, origin_};
+}
+
+
+CompactPath::iterator CompactPath::end() const {
+    return {&runs_, size_, origin_};
+}
+
+
+// Decode every cell of the path
+std::vector<Coord> CompactPath::coords() const {
+    std::vector<Coord> path;
+    path.reserve(size_);
+    for (const auto &c: *this) {
+        path.push_back(c);
+    }
+    return path;
+}
+
+
+// Greedily extend each straight line as far along the path as the line of sight holds, then start a new one from the
+// last cell that could be seen
+std::vector<Coord> CompactPath::waypoints(const Map::Ptr &map, double radius) const {
+    std::vector<Coord> points;
+    if (empty()) {
+        return points;
+    }
+    auto it = begin();
+    Coord anchor = *it;
+    Coord last = *it;
+    points.push_back(anchor);
+    for (++it; it != end(); ++it) {
+        if (!lineOfSight(map, anchor, *it, radius)) {
+            // a cell next to the anchor is only out of sight if it lacks clearance, it can't be skipped so it is kept
+            const bool adjacent = last.x == anchor.x && last.y == anchor.y;
+            anchor = adjacent ? *it : last;
+            points.push_back(anchor);
+        }
+        last = *it;
+    }
+    if (last.x != points.back().x || last.y != points.back().y) {
+        points.push_back(last);
+    }
+    return points;
+}
+
+
+// Write the signature, the origin, the number of cells and the runs
+bool CompactPath::write(std::ostream &out) const {
+    const int32_t header[2] = {origin_.x, origin_.y};
+    const uint64_t counts[2] = {size_, runs_.size()};
+    out.write(PATH_MAGIC, sizeof(PATH_MAGIC));
+    out.write(reinterpret_cast<const char *>(header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(counts), sizeof(counts));
+    out.write(reinterpret_cast<const char *>(runs_.data()), std::streamsize(runs_.size()));
+    return bool(out);
+}
+
+
+// Read a path written by write, checking the runs hold exactly one step fewer than the path has cells.
+// The counts in the header aren't trusted to size anything: the runs are read in chunks of bounded size, so a
+// malformed header makes the read fail once the stream ends rather than allocate what the header claims.
+bool CompactPath::read(std::istream &in) {
+    *this = CompactPath();
+    char magic[sizeof(PATH_MAGIC)];
+    int32_t header[2];
+    uint64_t counts[2];
+    if (!in.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), PATH_MAGIC)
+        || !in.read(reinterpret_cast<char *>(header), sizeof(header))
+        || !in.read(reinterpret_cast<char *>(counts), sizeof(counts))) {
+        return false;
+    }
+
+    // Each run holds between 1 and MAX_RUN steps
+    if (counts[1] > counts[0] || (counts[0] > 0 && (counts[0] - 1) / MAX_RUN > counts[1])) {
+        return false;
+    }
+    const uint64_t chunk = 1 << 16;
+    std::vector<uint8_t> runs;
+    while (runs.size() < counts[1]) {
+        const std::size_t read = runs.size();
+        runs.resize(read + std::size_t(std::min(chunk, counts[1] - read)));
+        if (!in.read(reinterpret_cast<char *>(runs.data() + read), std::streamsize(runs.size() - read))) {
+            return false;
+        }
+    }
+    uint64_t steps = 0;
+    for (const uint8_t run: runs) {
+        steps += (run & 31) + 1;
+    }
+    if (counts[0] == 0 ? !runs.empty() : steps != counts[0] - 1) {
+        return false;
+    }
+    origin_ = Coord(header[0], header[1]);
+    size_ = counts[0];
+    runs_ = std::move(runs);
+    return true;
+}
@@ -0,0 +1,44 @@
+#include "../include/PathQuery.h"
+
+
+PathQuery::Guard::Guard(std::shared_ptr<std::atomic<bool>> cancel) : cancel_(std::move(cancel)) {}
+
+
+// Nothing is left to receive the path, so the search can stop
+PathQuery::Guard::~Guard() {
+    cancel_->store(true);
+}
+
+
+PathQuery::PathQuery(std::shared_future<std::vector<Coord>> result, std::shared_ptr<std::atomic<bool>> cancel)
+        : result_(std::move(result)), cancel_(cancel), guard_(std::make_shared<Guard>(std::move(cancel))) {}
+
+
+// Ask the search to stop, it checks before expanding each node
+void PathQuery::cancel() {
+    cancel_->store(true);
+}
+
+
+// Check whether the search was asked to stop
+bool PathQuery::cancelled() const {
+    return cancel_->load();
+}
+
+
+// Check whether the search has finished, without blocking
+bool PathQuery::ready() const {
+    return result_.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+
+// Block until the search has finished
+void PathQuery::wait() const {
+    result_.wait();
+}
+
+
+// Block until the search has finished and return its path
+const std::vector<Coord> &PathQuery::get() const {
+    return result_.get();
+}
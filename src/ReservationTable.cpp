@@ -0,0 +1,126 @@
+#include "../include/ReservationTable.h"
+
+
+ReservationTable::ReservationTable(int bucket_size) : bucket_size_(std::max(1, bucket_size)), max_radius_(0),
+                                                      last_step_(-1) {}
+
+
+// Pack a time step and bucket into one key, parked robots use time step 0
+uint64_t ReservationTable::key(int t, int bx, int by) {
+    return (uint64_t(uint32_t(t)) << 40) ^ (uint64_t(uint32_t(bx) & 0xFFFFF) << 20) ^ (uint64_t(uint32_t(by) & 0xFFFFF));
+}
+
+
+// Check whether a disc overlaps any of the footprints in a list that are present at time step t
+bool ReservationTable::overlaps(const std::vector<Footprint> &footprints, const Coord &c, double radius, int t) {
+    for (const auto &f: footprints) {
+        if (f.from <= t && f.c.dist(c) < f.radius + radius) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// Reserve every step of a path in the bucket holding it, and park the robot at the end
+void ReservationTable::reserve(const std::vector<Coord> &path, double radius) {
+    if (path.empty()) {
+        return;
+    }
+    max_radius_ = std::max(max_radius_, radius);
+    const int end = int(path.size()) - 1;
+    for (int t = 0; t <= end; t++) {
+        const int bx = path[t].x / bucket_size_;
+        const int by = path[t].y / bucket_size_;
+        if (t < end) {
+            moving_[key(t, bx, by)].push_back({path[t], radius, 0});
+        } else {
+            parked_[key(0, bx, by)].push_back({path[t], radius, end});
+        }
+        auto &last = last_change_[key(0, bx, by)];
+        last = std::max(last, t);
+    }
+    last_step_ = std::max(last_step_, end - 1);
+}
+
+
+// Only the footprint is removed, the bucket's last change and the largest radius stay as upper bounds
+void ReservationTable::release(const Coord &c, double radius) {
+    auto iter = parked_.find(key(0, c.x / bucket_size_, c.y / bucket_size_));
+    if (iter == parked_.end()) {
+        return;
+    }
+    auto &footprints = iter->second;
+    for (auto f = footprints.begin(); f != footprints.end(); f++) {
+        if (f->from == 0 && f->c.x == c.x && f->c.y == c.y && f->radius == radius) {
+            footprints.erase(f);
+            return;
+        }
+    }
+}
+
+
+// Look at every bucket close enough to hold a footprint overlapping the disc
+bool ReservationTable::isFree(const Coord &c, int t, double radius) const {
+    const int reach = int(std::ceil(radius + max_radius_));
+    const int lbx = (std::max(0, c.x - reach)) / bucket_size_;
+    const int ubx = (c.x + reach) / bucket_size_;
+    const int lby = (std::max(0, c.y - reach)) / bucket_size_;
+    const int uby = (c.y + reach) / bucket_size_;
+    for (int bx = lbx; bx <= ubx; bx++) {
+        for (int by = lby; by <= uby; by++) {
+            if (t <= last_step_) {
+                auto iter = moving_.find(key(t, bx, by));
+                if (iter != moving_.end() && overlaps(iter->second, c, radius, t)) {
+                    return false;
+                }
+            }
+            auto iter = parked_.find(key(0, bx, by));
+            if (iter != parked_.end() && overlaps(iter->second, c, radius, t)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+// The last time step any bucket close enough to hold an overlapping footprint changes
+int ReservationTable::lastChange(const Coord &c, double radius) const {
+    const int reach = int(std::ceil(radius + max_radius_));
+    const int lbx = (std::max(0, c.x - reach)) / bucket_size_;
+    const int ubx = (c.x + reach) / bucket_size_;
+    const int lby = (std::max(0, c.y - reach)) / bucket_size_;
+    const int uby = (c.y + reach) / bucket_size_;
+    int last = -1;
+    for (int bx = lbx; bx <= ubx; bx++) {
+        for (int by = lby; by <= uby; by++) {
+            auto iter = last_change_.find(key(0, bx, by));
+            if (iter != last_change_.end()) {
+                last = std::max(last, iter->second);
+            }
+        }
+    }
+    return last;
+}
+
+
+// A robot can stay put if no robot planned earlier passes by later on
+bool ReservationTable::isFreeFrom(const Coord &c, int t, double radius) const {
+    for (int s = t; s <= std::max(t, last_step_ + 1); s++) {
+        if (!isFree(c, s, radius)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// Remove all reservations
+void ReservationTable::clear() {
+    moving_.clear();
+    parked_.clear();
+    last_change_.clear();
+    max_radius_ = 0;
+    last_step_ = -1;
+}
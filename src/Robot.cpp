@@ -3,6 +3,7 @@
 //
 
 
+#include <thread>
 #include <utility>
 
 
@@ -14,10 +15,11 @@ struct Qobject {
     double space; // Available space for movement
     double dist; // Distance from the current node to the target
     Coord coord; // Coordinates of the current node
+    int step; // Time step at which the node is reached, when planning over time
 
 
     // Constructor to initialize the object
-    Qobject(double s, double d, Coord c) : space(s), dist(d), coord(c) {}
+    Qobject(double s, double d, Coord c, int t = 0) : space(s), dist(d), coord(c), step(t) {}
 };
 
 
@@ -126,7 +128,7 @@ cv::Mat Robot::showOnMap(bool show_heat_map, const std::vector<std::vector<Coord
 
     // Display obstacles on the map
     for (const auto &obj: map_->getObstacles()) {
-        cv::circle(image, {obj->y(), obj->x()}, int(obj->radius), cv::Vec3b(255, 0, 0), -1);
+        obj->draw(image, cv::Vec3b(255, 0, 0));
     }
 
 
@@ -158,30 +160,103 @@ cv::Mat Robot::showOnMap(bool show_heat_map, const std::vector<std::vector<Coord
 }
 
 
-// Finds the safest path
-[[nodiscard]] std::vector<Coord> Robot::pathFind(double lambda, bool save, const std::string &fn) {
+// Checks that the robot is ready for pathFind to be called
+bool Robot::readyToPlan(double lambda) {
     if (map_ == nullptr) {
         std::cerr << "Give the robot a map before pathFind is called.\n";
-        return {};
+        return false;
     }
     if (coord.x < 0 || coord.x >= map_->rows || coord.y < 0 || coord.y >= map_->cols) {
         std::cerr << "Start location is out of bounds for given map. Set start in bounds before pathFind is called.\n";
-        return {};
+        return false;
     }
     if (map_->valAt(coord) < radius) {
         std::cerr
                 << "Robot can't fit in the start location. Set start somewhere the robot can fit before pathFind is called\n";
-        return {};
+        return false;
     }
     if (target_.x < 0 || target_.x >= map_->rows || target_.y < 0 || target_.y >= map_->cols) {
         std::cerr << "Target is out of bounds for given map. Set target in bounds before pathFind is called.\n";
+        return false;
+    }
+    if (lambda < 0 || lambda > 1) {
+        throw std::invalid_argument("Invalid value for lambda. Valid range is [0, 1]\n");
+    }
+    return true;
+}
+
+
+// Finds the safest path
+[[nodiscard]] std::vector<Coord> Robot::pathFind(double lambda, bool save, const std::string &fn) {
+    if (!readyToPlan(lambda)) {
         return {};
     }
+    return search(lambda, nullptr, save, fn, nullptr, nullptr, 0);
+}
+
+
+// Finds the safest path within a window of the site, after centering the window on the robot.
+// The path stays inside the window, so the robot doesn't need a map of the whole site.
+std::vector<Coord> Robot::pathFind(double lambda, LocalMap &window) {
     if (lambda < 0 || lambda > 1) {
         throw std::invalid_argument("Invalid value for lambda. Valid range is [0, 1]\n");
     }
-    const int rows = map_->rows;
-    const int cols = map_->cols;
+    if (coord.x < 0 || coord.x >= window.site_rows || coord.y < 0 || coord.y >= window.site_cols) {
+        std::cerr << "Start location is out of bounds for given map. Set start in bounds before pathFind is called.\n";
+        return {};
+    }
+    window.recenter(coord.x, coord.y);
+    if (window.valAt(coord) < radius) {
+        std::cerr
+                << "Robot can't fit in the start location. Set start somewhere the robot can fit before pathFind is called\n";
+        return {};
+    }
+    if (!window.contains(target_.x, target_.y)) {
+        std::cerr << "Target is outside the robot's local map. Set a target within the window before pathFind is called.\n";
+        return {};
+    }
+    return search(lambda, &window, false, "", nullptr, nullptr, 0);
+}
+
+
+// Starts finding the safest path on a detached thread. The search works on a copy of the robot, which also keeps the
+// map alive, so the robot can be moved or retargeted while it runs, but the map must not change until it has finished.
+// Dropping every PathQuery of the search cancels it, and never waits for it.
+PathQuery Robot::pathFindAsync(double lambda, const ProgressCallback &progress, int progress_interval) {
+    auto cancel = std::make_shared<std::atomic<bool>>(false);
+    std::promise<std::vector<Coord>> result;
+    auto future = result.get_future().share();
+    if (!readyToPlan(lambda)) {
+        result.set_value({});
+        return {future, cancel};
+    }
+    std::thread([robot = *this, lambda, cancel, progress, progress_interval, result = std::move(result)]() mutable {
+        try {
+            result.set_value(robot.search(lambda, nullptr, false, "", cancel.get(), progress, progress_interval));
+        } catch (...) {
+            result.set_exception(std::current_exception());
+        }
+    }).detach();
+    return {future, cancel};
+}
+
+
+// The search behind pathFind, over the robot's map or, if one is given, over a window of the site. The search runs in
+// the coordinates of the window and the path is moved back to site coordinates at the end.
+// It stops early, with no path, once cancel is set, and reports its progress every progress_interval expanded nodes
+// and once it's done.
+std::vector<Coord> Robot::search(double lambda, const LocalMap *window, bool save, const std::string &fn,
+                                 const std::atomic<bool> *cancel, const ProgressCallback &progress,
+                                 int progress_interval) {
+    const int rows = window ? window->rows : map_->rows;
+    const int cols = window ? window->cols : map_->cols;
+    const int origin_x = window ? window->originX() : 0;
+    const int origin_y = window ? window->originY() : 0;
+    const Coord start(coord.x - origin_x, coord.y - origin_y);
+    const Coord target(target_.x - origin_x, target_.y - origin_y);
+    auto valAt = [&](const Coord &c) {
+        return window ? window->valAt(c.x + origin_x, c.y + origin_y) : map_->valAt(c);
+    };
 
 
     const double max_d = std::hypot(rows, cols);
@@ -194,17 +269,22 @@ cv::Mat Robot::showOnMap(bool show_heat_map, const std::vector<std::vector<Coord
 
     // to track visited
     std::vector<bool> visited(rows * cols, false);
-    visited[coord.x * cols + coord.y] = true;
+    visited[start.x * cols + start.y] = true;
 
 
     // to decide which coordinate to pop next
     std::priority_queue<Qobject, std::vector<Qobject>, Qcomp> pq((Qcomp(lambda)));
-    pq.emplace(0, 0, coord);
+    pq.emplace(0, 0, start);
 
 
     // for display purposes
     std::vector<Coord> search;
-    search.reserve(rows * cols);
+    search.reserve(save ? rows * cols : 0);
+
+
+    // for progress reports
+    PathProgress status{0, start.dist(target)};
+    progress_interval = std::max(progress_interval, 1);
 
 
     while (!pq.empty()) {
@@ -212,13 +292,26 @@ cv::Mat Robot::showOnMap(bool show_heat_map, const std::vector<std::vector<Coord
         pq.pop();
 
 
+        // stop if the query is no longer wanted
+        if (cancel != nullptr && cancel->load(std::memory_order_relaxed)) {
+            return {};
+        }
+
+
         if (save) {
             search.push_back(cur_c);
         }
 
 
+        status.expanded++;
+        status.best_dist = std::min(status.best_dist, cur_c.dist(target));
+        if (progress && status.expanded % progress_interval == 0) {
+            progress(status);
+        }
+
+
         // break if we've reached target
-        if (cur_c.x == target_.x && cur_c.y == target_.y) {
+        if (cur_c.x == target.x && cur_c.y == target.y) {
             break;
         }
 
@@ -226,12 +319,12 @@ cv::Mat Robot::showOnMap(bool show_heat_map, const std::vector<std::vector<Coord
         // search surrounding nodes
         for (const auto &next_c: cur_c.surrounding(rows, cols)) {
             const auto next_key = next_c.x * cols + next_c.y;
-            const auto next_s = map_->valAt(next_c);
+            const auto next_s = valAt(next_c);
 
 
             // if we haven't visited this node and the robot can fit
             if (!visited[next_key] && next_s >= radius) {
-                pq.emplace(next_s / max_s, next_c.dist(target_) / max_d, next_c);
+                pq.emplace(next_s / max_s, next_c.dist(target) / max_d, next_c);
                 visited[next_key] = true;
                 links[next_key] = cur_c;
             }
@@ -239,21 +332,26 @@ cv::Mat Robot::showOnMap(bool show_heat_map, const std::vector<std::vector<Coord
     }
 
 
-    // backtrace the path
-    std::vector<Coord> path;
-    path.reserve(rows * cols);
-    Coord prev = target_;
-    if (links[prev.x * cols + prev.y].x == -1) {
+    if (progress) {
+        progress(status);
+    }
+
+
+    // backtrace the path, counting its length first so it is allocated once at its exact size
+    if (links[target.x * cols + target.y].x == -1) {
         std::cerr << "Impossible to reach target...\n";
         return {};
     }
-    while (prev.x != coord.x || prev.y != coord.y) {
-        path.push_back(prev);
-        int next_key = prev.x * cols + prev.y;
-        prev = links[next_key];
+    std::size_t length = 1;
+    for (Coord prev = target; prev.x != start.x || prev.y != start.y; prev = links[prev.x * cols + prev.y]) {
+        length++;
+    }
+    std::vector<Coord> path(length, coord);
+    Coord prev = target;
+    while (prev.x != start.x || prev.y != start.y) {
+        path[--length] = Coord(prev.x + origin_x, prev.y + origin_y);
+        prev = links[prev.x * cols + prev.y];
     }
-    path.push_back(prev);
-    std::reverse(path.begin(), path.end());
 
 
     // save journey
@@ -286,6 +384,348 @@ cv::Mat Robot::showOnMap(bool show_heat_map, const std::vector<std::vector<Coord
 
 
 
+// Follows links from a coordinate back to the coordinate a search started from, both included
+static std::vector<Coord> backtrace(const std::vector<Coord> &links, int cols, Coord from, const Coord &to) {
+    std::vector<Coord> chain;
+    while (from.x != to.x || from.y != to.y) {
+        chain.push_back(from);
+        from = links[from.x * cols + from.y];
+    }
+    chain.push_back(to);
+    return chain;
+}
+
+
+// Finds the safest path by searching from both the start and the target until the two searches meet. Each side is
+// ordered by the same Qcomp trade-off, toward the other end, so long corridors are covered by two small wavefronts.
+std::vector<Coord> Robot::pathFindBidirectional(double lambda) {
+    if (!readyToPlan(lambda)) {
+        return {};
+    }
+    if (map_->valAt(target_) < radius) {
+        std::cerr << "Impossible to reach target...\n";
+        return {};
+    }
+    if (coord.x == target_.x && coord.y == target_.y) {
+        return {coord};
+    }
+    const int rows = map_->rows;
+    const int cols = map_->cols;
+
+
+    const double max_d = std::hypot(rows, cols);
+    const double max_s = std::max(rows, cols) / 2.;
+
+
+    // side 0 searches from the start toward the target, side 1 from the target toward the start
+    const Coord ends[2] = {coord, target_};
+    std::vector<Coord> links[2] = {std::vector<Coord>(rows * cols, {-1, -1}), std::vector<Coord>(rows * cols, {-1, -1})};
+
+
+    // the side that visited each cell, or -1
+    std::vector<signed char> owner(rows * cols, -1);
+    owner[coord.x * cols + coord.y] = 0;
+    owner[target_.x * cols + target_.y] = 1;
+
+
+    std::priority_queue<Qobject, std::vector<Qobject>, Qcomp> pq[2] = {
+            std::priority_queue<Qobject, std::vector<Qobject>, Qcomp>((Qcomp(lambda))),
+            std::priority_queue<Qobject, std::vector<Qobject>, Qcomp>((Qcomp(lambda)))};
+    pq[0].emplace(0, 0, coord);
+    pq[1].emplace(0, 0, target_);
+
+
+    // the two adjacent cells where the sides meet, reached from the start and from the target
+    Coord meet[2] = {{-1, -1}, {-1, -1}};
+    int side = 0;
+    while (meet[0].x == -1 && (!pq[0].empty() || !pq[1].empty())) {
+        if (pq[side].empty()) {
+            side = 1 - side;
+        }
+        const auto cur_c = pq[side].top().coord;
+        pq[side].pop();
+
+
+        // search surrounding nodes
+        for (const auto &next_c: cur_c.surrounding(rows, cols)) {
+            const auto next_key = next_c.x * cols + next_c.y;
+            if (owner[next_key] == side) {
+                continue;
+            }
+            const auto next_s = map_->valAt(next_c);
+            if (next_s < radius) {
+                continue;
+            }
+
+
+            // stop once a node reached by the other side is found
+            if (owner[next_key] == 1 - side) {
+                meet[side] = cur_c;
+                meet[1 - side] = next_c;
+                break;
+            }
+            pq[side].emplace(next_s / max_s, next_c.dist(ends[1 - side]) / max_d, next_c);
+            owner[next_key] = char(side);
+            links[side][next_key] = cur_c;
+        }
+        side = 1 - side;
+    }
+
+
+    if (meet[0].x == -1) {
+        std::cerr << "Impossible to reach target...\n";
+        return {};
+    }
+
+
+    // join the start side, reversed, with the target side
+    std::vector<Coord> path = backtrace(links[0], cols, meet[0], coord);
+    std::reverse(path.begin(), path.end());
+    const auto rest = backtrace(links[1], cols, meet[1], target_);
+    path.insert(path.end(), rest.begin(), rest.end());
+    return path;
+}
+
+
+// Finds the safest path for each of several lambda values in one pass. The searches take turns expanding a node, and
+// what doesn't depend on lambda is worked out once per cell and shared: its clearance, its distance to the target and
+// which of its neighbors the robot fits in.
+std::vector<std::vector<Coord>> Robot::pathFind(const std::vector<double> &lambdas) {
+    for (const double lambda: lambdas) {
+        if (!readyToPlan(lambda)) {
+            return std::vector<std::vector<Coord>>(lambdas.size());
+        }
+    }
+    const int rows = map_->rows;
+    const int cols = map_->cols;
+    const int n = int(lambdas.size());
+
+
+    const double max_d = std::hypot(rows, cols);
+    const double max_s = std::max(rows, cols) / 2.;
+
+
+    // the normalized space and distance of each cell, space is -1 until the cell is looked up
+    std::vector<double> space(rows * cols, -1);
+    std::vector<double> dist(rows * cols);
+    auto lookUp = [&](int x, int y) {
+        const int key = x * cols + y;
+        if (space[key] < 0) {
+            space[key] = map_->valAt(x, y);
+            dist[key] = Coord(x, y).dist(target_) / max_d;
+        }
+        return key;
+    };
+
+
+    // the neighbors of each cell the robot fits in, one bit per offset in the order of Coord::surrounding,
+    // with bit 8 set once the cell's neighbors are known
+    static constexpr int offsets[8][2] = {{-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1}};
+    std::vector<uint16_t> fits(rows * cols, 0);
+    auto neighbors = [&](const Coord &c) {
+        uint16_t &mask = fits[c.x * cols + c.y];
+        if (mask == 0) {
+            mask = 1 << 8;
+            for (int d = 0; d < 8; d++) {
+                const int x = c.x + offsets[d][0];
+                const int y = c.y + offsets[d][1];
+                if (x >= 0 && x < rows && y >= 0 && y < cols && space[lookUp(x, y)] >= radius) {
+                    mask |= 1 << d;
+                }
+            }
+        }
+        return mask;
+    };
+
+
+    // one search per lambda, each links a cell to the key of the cell it was reached from, or -1 if it wasn't reached
+    const int start_key = coord.x * cols + coord.y;
+    std::vector<std::vector<int>> links(n, std::vector<int>(rows * cols, -1));
+    std::vector<std::priority_queue<Qobject, std::vector<Qobject>, Qcomp>> pq;
+    std::vector<bool> done(n, false);
+    pq.reserve(n);
+    for (int i = 0; i < n; i++) {
+        pq.emplace_back(Qcomp(lambdas[i]));
+        pq[i].emplace(0, 0, coord);
+        links[i][start_key] = start_key;
+    }
+
+
+    for (int active = n; active > 0;) {
+        for (int i = 0; i < n; i++) {
+            if (done[i]) {
+                continue;
+            }
+            if (pq[i].empty()) {
+                done[i] = true;
+                active--;
+                continue;
+            }
+            const auto cur_c = pq[i].top().coord;
+            const int cur_key = cur_c.x * cols + cur_c.y;
+            pq[i].pop();
+
+
+            // stop this search if it has reached the target
+            if (cur_c.x == target_.x && cur_c.y == target_.y) {
+                done[i] = true;
+                active--;
+                continue;
+            }
+
+
+            // search surrounding nodes the robot fits in
+            const uint16_t mask = neighbors(cur_c);
+            for (int d = 0; d < 8; d++) {
+                if (!(mask & (1 << d))) {
+                    continue;
+                }
+                const Coord next_c(cur_c.x + offsets[d][0], cur_c.y + offsets[d][1]);
+                const int next_key = next_c.x * cols + next_c.y;
+                if (links[i][next_key] == -1) {
+                    pq[i].emplace(space[next_key] / max_s, dist[next_key], next_c);
+                    links[i][next_key] = cur_key;
+                }
+            }
+        }
+    }
+
+
+    // backtrace each path
+    const int target_key = target_.x * cols + target_.y;
+    std::vector<std::vector<Coord>> paths(n);
+    for (int i = 0; i < n; i++) {
+        if (links[i][target_key] == -1) {
+            std::cerr << "Impossible to reach target with lambda " << lambdas[i] << "...\n";
+            continue;
+        }
+        for (int key = target_key; key != start_key; key = links[i][key]) {
+            paths[i].emplace_back(key / cols, key % cols);
+        }
+        paths[i].push_back(coord);
+        std::reverse(paths[i].begin(), paths[i].end());
+    }
+    return paths;
+}
+
+
+// Finds the safest path that avoids the robots already in the reservation table, by searching over space and time.
+// The robot may also wait in place, and the returned path holds the robot's position at each time step.
+std::vector<Coord> Robot::pathFind(double lambda, const ReservationTable &reservations, int max_steps) {
+    if (!readyToPlan(lambda)) {
+        return {};
+    }
+    if (!reservations.isFree(coord, 0, radius)) {
+        std::cerr << "Start location is reserved by another robot.\n";
+        return {};
+    }
+    const int rows = map_->rows;
+    const int cols = map_->cols;
+    const uint64_t cells = uint64_t(rows) * cols;
+    if (max_steps <= 0) {
+        max_steps = 2 * (rows + cols);
+    }
+
+    const double max_d = std::hypot(rows, cols);
+    const double max_s = std::max(rows, cols) / 2.;
+
+    // to store the path and track visited, keyed by time step and cell. Once no reservation can change near a cell
+    // anymore, reaching it later is no better than reaching it earlier, so all those time steps share one key.
+    const uint64_t settled = uint64_t(max_steps) + 1;
+    std::vector<int> last_change(cells, -2);
+    auto keyOf = [&](const Coord &c, int t) {
+        const uint64_t cell = uint64_t(c.x) * cols + c.y;
+        if (last_change[cell] == -2) {
+            last_change[cell] = reservations.lastChange(c, radius);
+        }
+        return (t > last_change[cell] ? settled : uint64_t(t)) * cells + cell;
+    };
+    std::unordered_map<uint64_t, uint64_t> links;
+    const uint64_t start_key = keyOf(coord, 0);
+    links[start_key] = start_key;
+
+    // to decide which coordinate to pop next
+    std::priority_queue<Qobject, std::vector<Qobject>, Qcomp> pq((Qcomp(lambda)));
+    pq.emplace(0, 0, coord, 0);
+
+    uint64_t goal_key = 0;
+    int goal_t = -1;
+    while (!pq.empty()) {
+        const auto cur_c = pq.top().coord;
+        const int t = pq.top().step;
+        pq.pop();
+        const uint64_t cur_key = keyOf(cur_c, t);
+
+        // stop once we're at the target and no earlier robot passes through it later
+        if (cur_c.x == target_.x && cur_c.y == target_.y && reservations.isFreeFrom(cur_c, t, radius)) {
+            goal_key = cur_key;
+            goal_t = t;
+            break;
+        }
+        if (t >= max_steps) {
+            continue;
+        }
+
+        // search surrounding nodes and waiting in place, one time step later
+        auto next_cs = cur_c.surrounding(rows, cols);
+        next_cs.push_back(cur_c);
+        for (const auto &next_c: next_cs) {
+            const uint64_t next_key = keyOf(next_c, t + 1);
+            if (links.count(next_key)) {
+                continue;
+            }
+            const auto next_s = map_->valAt(next_c);
+
+            // the robot must fit, and stay clear of the other robots both while moving and once it has moved
+            if (next_s >= radius && reservations.isFree(next_c, t + 1, radius) &&
+                reservations.isFree(next_c, t, radius)) {
+                links[next_key] = cur_key;
+                pq.emplace(next_s / max_s, next_c.dist(target_) / max_d, next_c, t + 1);
+            }
+        }
+    }
+
+    if (goal_t < 0) {
+        std::cerr << "Impossible to reach target without crossing the other robots...\n";
+        return {};
+    }
+
+    // backtrace the path, each link is one time step
+    std::vector<Coord> path(goal_t + 1, coord);
+    int t = goal_t;
+    for (uint64_t key = goal_key; key != start_key; key = links[key]) {
+        const uint64_t cell = key % cells;
+        path[t--] = Coord(int(cell / cols), int(cell % cols));
+    }
+    return path;
+}
+
+
+// Plans the robots one after the other in the given order, each one avoiding the robots planned before it.
+// The robots not planned yet are reserved at their starts, so a robot planned earlier can't run through one that
+// hasn't left. A robot that can't reach its target stays reserved at its start, so the robots after it go around it.
+std::vector<std::vector<Coord>> Robot::pathFindAll(const std::vector<Robot::Ptr> &robots, double lambda, int max_steps) {
+    ReservationTable reservations;
+    for (const auto &robot: robots) {
+        reservations.reserve({robot->coord}, robot->radius);
+    }
+    std::vector<std::vector<Coord>> paths;
+    paths.reserve(robots.size());
+    for (const auto &robot: robots) {
+        reservations.release(robot->coord, robot->radius);
+        paths.push_back(robot->pathFind(lambda, reservations, max_steps));
+        if (paths.back().empty()) {
+            reservations.reserve({robot->coord}, robot->radius);
+        } else {
+            reservations.reserve(paths.back(), robot->radius);
+        }
+    }
+    return paths;
+}
+
+
+
+
 void Robot::printParameters() const {
     std::cout << "Start: (" << coord.x << ", " << coord.y << ")\n";
     std::cout << "Target: (" << target_.x << ", " << target_.y << ")\n";
@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <limits>
+#include <opencv2/imgproc.hpp>
+
+#include "../include/Shapes.h"
+
+
+// Calculate the distance between a coordinate and the segment from a to b
+static double segmentDist(const Coord &c, const Coord &a, const Coord &b) {
+    const double dx = b.x - a.x;
+    const double dy = b.y - a.y;
+    const double len2 = dx * dx + dy * dy;
+    if (len2 == 0) {
+        return a.dist(c);
+    }
+    // Project the coordinate onto the segment and clamp to its endpoints
+    const double t = std::min(1., std::max(0., ((c.x - a.x) * dx + (c.y - a.y) * dy) / len2));
+    return std::hypot(c.x - (a.x + t * dx), c.y - (a.y + t * dy));
+}
+
+
+// Create a shared pointer to a Segment instance
+Segment::Ptr Segment::create(int x0, int y0, int x1, int y1, double r) {
+    return std::make_shared<Segment>(x0, y0, x1, y1, r);
+}
+
+
+Shape Segment::shape() const {
+    return Shape::Segment;
+}
+
+
+// A Segment is described by its two endpoints and its half width
+std::vector<double> Segment::params() const {
+    return {double(coord.x), double(coord.y), double(end_.x), double(end_.y), radius};
+}
+
+
+bool Segment::valid() const {
+    return radius >= 0;
+}
+
+
+// Distance from the edge of the inflated segment
+double Segment::clearance(const Coord &c) const {
+    return std::max(0., segmentDist(c, coord, end_) - radius);
+}
+
+
+// Move both endpoints
+void Segment::translate(int dx, int dy) {
+    Object::translate(dx, dy);
+    end_.x += dx;
+    end_.y += dy;
+}
+
+
+// A Segment extends to its far endpoint
+double Segment::extent() const {
+    return coord.dist(end_) + radius;
+}
+
+
+// Draw the Segment as a line as thick as the Segment is wide
+void Segment::draw(cv::Mat &image, const cv::Vec3b &color) const {
+    cv::line(image, {coord.y, coord.x}, {end_.y, end_.x}, color, std::max(1, int(2 * radius) + 1));
+}
+
+
+// Create a shared pointer to a Box instance
+Box::Ptr Box::create(int x0, int y0, int x1, int y1) {
+    return std::make_shared<Box>(x0, y0, x1, y1);
+}
+
+
+Shape Box::shape() const {
+    return Shape::Box;
+}
+
+
+// A Box is described by its two corners
+std::vector<double> Box::params() const {
+    return {double(coord.x), double(coord.y), double(hi_.x), double(hi_.y)};
+}
+
+
+// Any Box covers at least one cell
+bool Box::valid() const {
+    return true;
+}
+
+
+// Distance from the nearest side of the Box
+double Box::clearance(const Coord &c) const {
+    const int dx = std::max({coord.x - c.x, 0, c.x - hi_.x});
+    const int dy = std::max({coord.y - c.y, 0, c.y - hi_.y});
+    return std::hypot(dx, dy);
+}
+
+
+// Move both corners
+void Box::translate(int dx, int dy) {
+    Object::translate(dx, dy);
+    hi_.x += dx;
+    hi_.y += dy;
+}
+
+
+// A Box extends to its opposite corner
+double Box::extent() const {
+    return coord.dist(hi_);
+}
+
+
+// Draw the Box as a filled rectangle
+void Box::draw(cv::Mat &image, const cv::Vec3b &color) const {
+    cv::rectangle(image, {coord.y, coord.x}, {hi_.y, hi_.x}, color, -1);
+}
+
+
+Polygon::Polygon(const std::vector<Coord> &vertices)
+        : Object(vertices.empty() ? 0 : vertices[0].x, vertices.empty() ? 0 : vertices[0].y, 0),
+          vertices_(vertices) {}
+
+
+// Create a shared pointer to a Polygon instance
+Polygon::Ptr Polygon::create(const std::vector<Coord> &vertices) {
+    return std::make_shared<Polygon>(vertices);
+}
+
+
+Shape Polygon::shape() const {
+    return Shape::Polygon;
+}
+
+
+// A Polygon is described by the x and y coordinate of each of its vertices
+std::vector<double> Polygon::params() const {
+    std::vector<double> p;
+    p.reserve(2 * vertices_.size());
+    for (const auto &v: vertices_) {
+        p.push_back(v.x);
+        p.push_back(v.y);
+    }
+    return p;
+}
+
+
+bool Polygon::valid() const {
+    return vertices_.size() >= 3;
+}
+
+
+// Distance from the nearest edge of the Polygon, or 0 if the coordinate is inside it
+double Polygon::clearance(const Coord &c) const {
+    bool inside = false;
+    double dist = std::numeric_limits<double>::max();
+    for (size_t i = 0, j = vertices_.size() - 1; i < vertices_.size(); j = i++) {
+        const Coord &a = vertices_[i];
+        const Coord &b = vertices_[j];
+        // Even-odd rule: count the edges crossed by a ray from the coordinate in the +y direction
+        if ((a.x > c.x) != (b.x > c.x) &&
+            c.y < double(b.y - a.y) * (c.x - a.x) / double(b.x - a.x) + a.y) {
+            inside = !inside;
+        }
+        dist = std::min(dist, segmentDist(c, a, b));
+    }
+    return inside ? 0. : dist;
+}
+
+
+// Move every vertex
+void Polygon::translate(int dx, int dy) {
+    Object::translate(dx, dy);
+    for (auto &v: vertices_) {
+        v.x += dx;
+        v.y += dy;
+    }
+}
+
+
+// A Polygon extends to its farthest vertex
+double Polygon::extent() const {
+    double far = 0;
+    for (const auto &v: vertices_) {
+        far = std::max(far, coord.dist(v));
+    }
+    return far;
+}
+
+
+// Draw the Polygon filled
+void Polygon::draw(cv::Mat &image, const cv::Vec3b &color) const {
+    std::vector<cv::Point> points;
+    points.reserve(vertices_.size());
+    for (const auto &v: vertices_) {
+        points.emplace_back(v.y, v.x);
+    }
+    cv::fillPoly(image, std::vector<std::vector<cv::Point>>{points}, color);
+}